@@ -0,0 +1,194 @@
+/*
+ * File:   chunk_file.h
+ *
+ * Purpose: Files made of independently encoded chunks of rounds, such as the hand history and the
+ *          columnar export. Chunks are committed from worker threads in any order but written in
+ *          chunk order, and read back by mapping the file.
+ */
+
+#ifndef CHUNK_FILE_H
+#define CHUNK_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "profile.h"
+
+// Header at the start of a chunk file; the magic number says which kind of file it is
+struct ChunkFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+};
+
+// Header before each chunk
+struct ChunkHeader {
+    uint32_t rounds;
+    uint32_t bytes;
+};
+
+// A chunk file being written. Chunks can be committed from any thread in any order; each one is
+// written as soon as every chunk before it has been, so the file is the same for any number of
+// threads and only the chunks finished early are held in memory.
+class ChunkFile {
+private:
+    std::string path;
+    FILE* file;
+    std::mutex mutex;
+    long long nextChunk = 0;
+    std::map<long long, std::vector<uint8_t>> early;  // Encoded chunks waiting for the ones before them
+    long long rounds = 0;
+    long long bytes = 0;
+    bool failed = false;
+
+    // Appends bytes to the file
+    void write(const void* data, size_t size) {
+        failed = failed || fwrite(data, 1, size, file) != size;
+        bytes += size;
+    }
+
+public:
+    // Constructor: creates (or replaces) the file at the given path and writes its header
+    ChunkFile(const std::string& filename, uint32_t magic, uint16_t version)
+        : path(filename), file(fopen(filename.c_str(), "wb")) {
+        ChunkFileHeader header = {magic, version, 0};
+        failed = file == nullptr || fwrite(&header, sizeof(header), 1, file) != 1;
+        bytes = sizeof(header);
+    }
+
+    ~ChunkFile() {
+        close();
+    }
+
+    ChunkFile(const ChunkFile&) = delete;
+    ChunkFile& operator=(const ChunkFile&) = delete;
+
+    // Writes a finished chunk as the given chunk number, once every earlier number has been committed.
+    // Chunks in a row written from one thread are committed as 0, 1, 2, ... and go straight out.
+    void commit(long long index, uint32_t chunkRounds, const uint8_t* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file == nullptr) {
+            return;
+        }
+        ChunkHeader header = {chunkRounds, static_cast<uint32_t>(size)};
+        rounds += chunkRounds;
+        if (index != nextChunk) {
+            // Copy the chunk behind its header, to be written later
+            std::vector<uint8_t>& framed = early[index];
+            framed.resize(sizeof(header) + size);
+            memcpy(framed.data(), &header, sizeof(header));
+            memcpy(framed.data() + sizeof(header), data, size);
+            return;
+        }
+        write(&header, sizeof(header));
+        write(data, size);
+        for (nextChunk++; !early.empty() && early.begin()->first == nextChunk; nextChunk++) {
+            write(early.begin()->second.data(), early.begin()->second.size());
+            early.erase(early.begin());
+        }
+    }
+
+    // Flushes and closes the file; returns false if anything could not be written
+    bool close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file != nullptr) {
+            failed = failed || !early.empty() || fclose(file) != 0;
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+    long long getRounds() const {
+        return rounds;
+    }
+
+    long long getBytes() const {
+        return bytes;
+    }
+
+    const std::string& getPath() const {
+        return path;
+    }
+};
+
+// A chunk file mapped into memory. Only the pages that are read are ever loaded.
+class ChunkFileReader {
+private:
+    void* mapping = MAP_FAILED;
+    size_t size = 0;
+    bool valid = false;
+
+public:
+    // Constructor: maps the file if it starts with the given magic number and version
+    ChunkFileReader(const std::string& filename, uint32_t magic, uint16_t version) {
+        int descriptor = open(filename.c_str(), O_RDONLY | O_BINARY);
+        struct stat status;
+        if (descriptor < 0) {
+            return;
+        }
+        if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(ChunkFileHeader))) {
+            size = static_cast<size_t>(status.st_size);
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        }
+        close(descriptor);
+        if (mapping != MAP_FAILED) {
+            ChunkFileHeader header;
+            memcpy(&header, mapping, sizeof(header));
+            valid = header.magic == magic && header.version == version;
+        }
+    }
+
+    ~ChunkFileReader() {
+        if (mapping != MAP_FAILED) {
+            munmap(mapping, size);
+        }
+    }
+
+    ChunkFileReader(const ChunkFileReader&) = delete;
+    ChunkFileReader& operator=(const ChunkFileReader&) = delete;
+
+    bool isValid() const {
+        return valid;
+    }
+
+    // Tells the kernel how the file is going to be read, e.g. MADV_SEQUENTIAL
+    void advise(int advice) const {
+        if (valid) {
+            madvise(mapping, size, advice);
+        }
+    }
+
+    // Passes every chunk to visit(data, bytes, rounds) in file order. Stops at a chunk cut short, as
+    // a file still being written can end with one. Returns the number of chunks visited.
+    template <typename Visit>
+    long long forEachChunk(Visit visit) const {
+        if (!valid) {
+            return 0;
+        }
+        const uint8_t* data = static_cast<const uint8_t*>(mapping);
+        size_t offset = sizeof(ChunkFileHeader);
+        long long visited = 0;
+        while (offset + sizeof(ChunkHeader) <= size) {
+            ChunkHeader header;
+            memcpy(&header, data + offset, sizeof(header));
+            offset += sizeof(header);
+            if (header.bytes > size - offset) {
+                break;
+            }
+            visit(data + offset, static_cast<size_t>(header.bytes), header.rounds);
+            offset += header.bytes;
+            visited++;
+        }
+        return visited;
+    }
+};
+
+#endif /* CHUNK_FILE_H */
@@ -0,0 +1,544 @@
+/*
+ * File:   columns.h
+ *
+ * Purpose: Columnar export of simulated rounds for analysis. Every field of a round is stored as
+ *          its own column in chunks of rounds, each column encoded the way that makes it smallest,
+ *          so a scan of one field reads only that field's bytes.
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "chunk_file.h"
+
+const uint32_t EXPORT_MAGIC = 0x58434a42;  // "BJCX" in a little-endian file
+const uint16_t EXPORT_VERSION = 1;
+
+// Columns of the export, in the order they are stored in each chunk
+enum ExportColumn {
+    EXPORT_BET,           // Total stake in cents, doubled by a double down
+    EXPORT_PLAYER_TOTAL,  // Player's final total
+    EXPORT_DEALER_TOTAL,  // Dealer's final total, 0 when the dealer did not play
+    EXPORT_OUTCOME,       // RoundOutcome
+    EXPORT_PAYOUT,        // Net change of the balance in cents
+    EXPORT_BALANCE,       // Balance after the round in cents
+    EXPORT_LEVEL,         // Level after the round
+    EXPORT_COLUMNS
+};
+
+const char* const EXPORT_COLUMN_NAMES[EXPORT_COLUMNS] = {"bet", "player-total", "dealer-total", "outcome",
+                                                          "payout", "balance", "level"};
+
+// Every column holds whole numbers; money is kept in cents, which is what the balance is rounded to
+const double EXPORT_COLUMN_SCALE[EXPORT_COLUMNS] = {100.0, 1.0, 1.0, 1.0, 100.0, 100.0, 1.0};
+
+// How a column is stored in a chunk. Every column block starts with one of these in a byte:
+//   plain       width byte, then every value in that many bytes (1, 2, 4 or 8, signed)
+//   dictionary  width byte, 16-bit count, the distinct values in that width, a byte with the bits
+//               per code, then one code per round packed least significant bit first
+//   delta       the first value, then the difference from the value before, as zigzag varints
+//   runs        pairs of varints: the zigzag difference from the previous run's value, the run length
+enum ColumnEncoding : uint8_t {
+    ENCODING_PLAIN = 0,
+    ENCODING_DICTIONARY = 1,
+    ENCODING_DELTA = 2,
+    ENCODING_RUNS = 3,
+    ENCODINGS
+};
+
+const char* const ENCODING_NAMES[ENCODINGS] = {"plain", "dictionary", "delta", "runs"};
+
+// Most distinct values a dictionary column can have
+const int EXPORT_DICTIONARY_SIZE = 256;
+
+// Varint helpers: 7 bits per byte, least significant group first, the top bit set on all but the last
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Bytes a value takes as a varint. The loop has a fixed count, so it is unrolled without branches.
+inline size_t varintLength(uint64_t value) {
+    size_t length = 1;
+    for (int bits = 7; bits < 64; bits += 7) {
+        length += value >= (uint64_t(1) << bits);
+    }
+    return length;
+}
+
+// Writes a varint, moving out forward
+inline void putVarint(uint8_t*& out, uint64_t value) {
+    for (; value >= 0x80; value >>= 7) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+    }
+    *out++ = static_cast<uint8_t>(value);
+}
+
+// Reads a varint, moving data forward; returns false if it runs past end
+inline bool getVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; data < end && shift < 64; shift += 7) {
+        uint8_t byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes a plain value needs for every value between low and high
+inline int plainWidth(int64_t low, int64_t high) {
+    int width = 1;
+    while (width < 8 && (low < -(int64_t(1) << (8 * width - 1)) || high >= (int64_t(1) << (8 * width - 1)))) {
+        width *= 2;
+    }
+    return width;
+}
+
+// Reads a signed little-endian value of the given width
+inline int64_t getPlain(const uint8_t* data, int width) {
+    uint64_t value = 0;
+    memcpy(&value, data, width);
+    int shift = 64 - 8 * width;
+    return static_cast<int64_t>(value << shift) >> shift;
+}
+
+// Distinct values of a column. Values within EXPORT_DIRECT_RANGE of the column's lowest are looked up
+// directly by their distance from it, others in a small open-addressing hash table. Gives up as
+// soon as there are more than EXPORT_DICTIONARY_SIZE of them.
+class ColumnDictionary {
+public:
+    static const int DIRECT_RANGE = 8192;
+
+private:
+    static const int SLOTS = 2 * EXPORT_DICTIONARY_SIZE;
+    int16_t direct[DIRECT_RANGE];  // Code of low + i, -1 when the value is not in the dictionary
+    int64_t keys[SLOTS];
+    int16_t codes[SLOTS];          // -1 marks an empty slot
+    int64_t values[EXPORT_DICTIONARY_SIZE];
+    int count = 0;
+
+    int slotOf(int64_t value) const {
+        uint64_t hash = static_cast<uint64_t>(value) * 0x9e3779b97f4a7c15ull;
+        int slot = static_cast<int>(hash >> 55);
+        while (codes[slot] >= 0 && keys[slot] != value) {
+            slot = (slot + 1) & (SLOTS - 1);
+        }
+        return slot;
+    }
+
+    // Gives code the next code if it has none yet; returns false when the dictionary is full
+    bool assign(int16_t& code, int64_t value) {
+        if (code < 0) {
+            if (count == EXPORT_DICTIONARY_SIZE) {
+                return false;
+            }
+            code = static_cast<int16_t>(count);
+            values[count++] = value;
+        }
+        return true;
+    }
+
+public:
+    // Collects the distinct values of a column whose values lie between low and high, and stores the
+    // code of every row in rowCodes; returns false if there are too many for a dictionary
+    bool build(const int64_t* column, size_t rows, int64_t low, int64_t high, uint8_t* rowCodes) {
+        count = 0;
+        if (static_cast<uint64_t>(high - low) < DIRECT_RANGE) {
+            memset(direct, 0xff, sizeof(direct[0]) * static_cast<size_t>(high - low + 1));
+            for (size_t row = 0; row < rows; row++) {
+                int16_t& code = direct[column[row] - low];
+                if (!assign(code, column[row])) {
+                    return false;
+                }
+                rowCodes[row] = static_cast<uint8_t>(code);
+            }
+            return true;
+        }
+        memset(codes, 0xff, sizeof(codes));
+        for (size_t row = 0; row < rows; row++) {
+            int slot = slotOf(column[row]);
+            keys[slot] = column[row];
+            if (!assign(codes[slot], column[row])) {
+                return false;
+            }
+            rowCodes[row] = static_cast<uint8_t>(codes[slot]);
+        }
+        return true;
+    }
+
+    // Bits per code: enough to tell every value apart, none when there is only one
+    int codeBits() const {
+        int bits = 0;
+        while ((1 << bits) < count) {
+            bits++;
+        }
+        return bits;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    int64_t operator[](int code) const {
+        return values[code];
+    }
+};
+
+// One chunk of the export being built. Rounds are added as rows, which only stores each field in
+// its column; finish() then encodes every column, so adding a round costs a few stores. A bound on
+// each column's size is worked out under every encoding first, so the block is written in place once.
+class ExportChunk {
+private:
+    std::vector<int64_t> values;    // The columns one after the other, capacity values each
+    size_t capacity;
+    size_t rows = 0;
+    std::vector<uint8_t> rowCodes;  // Dictionary code of every row of the column being encoded
+    std::vector<uint8_t> encoded;   // Column offsets, then the column blocks
+    ColumnDictionary dictionary;
+
+    // Rounds to the nearest cent
+    static int64_t cents(float amount) {
+        double scaled = static_cast<double>(amount) * 100.0;
+        return static_cast<int64_t>(scaled + std::copysign(0.5, scaled));
+    }
+
+    // Makes room for twice as many rows; only a chunk bigger than the constructor expected needs it
+    void grow() {
+        size_t grown = std::max<size_t>(capacity * 2, 16);
+        std::vector<int64_t> moved(grown * EXPORT_COLUMNS);
+        for (int column = 0; column < EXPORT_COLUMNS; column++) {
+            std::copy(values.begin() + column * capacity, values.begin() + column * capacity + rows,
+                      moved.begin() + column * grown);
+        }
+        values.swap(moved);
+        rowCodes.resize(grown);
+        capacity = grown;
+    }
+
+    // Bounds on the size of a column under each encoding, in one cheap pass; the dictionary is built
+    // on the way. The longest delta decides the bound for the delta and run encodings.
+    void measure(const int64_t* column, size_t sizes[ENCODINGS], int& width) {
+        int64_t low = column[0];
+        int64_t high = column[0];
+        uint64_t deltaBits = zigzag(column[0]);
+        size_t runs = 1;
+        for (size_t row = 1; row < rows; row++) {
+            low = std::min(low, column[row]);
+            high = std::max(high, column[row]);
+            deltaBits |= zigzag(column[row] - column[row - 1]);
+            runs += column[row] != column[row - 1];
+        }
+
+        width = plainWidth(low, high);
+        sizes[ENCODING_PLAIN] = 2 + rows * width;
+        sizes[ENCODING_DICTIONARY] = dictionary.build(column, rows, low, high, rowCodes.data())
+            ? 5 + dictionary.size() * width + (rows * dictionary.codeBits() + 7) / 8 : SIZE_MAX;
+        sizes[ENCODING_DELTA] = 1 + rows * varintLength(deltaBits);
+        sizes[ENCODING_RUNS] = 1 + runs * (varintLength(deltaBits) + varintLength(rows));
+    }
+
+    static void putPlain(uint8_t*& out, int64_t value, int width) {
+        memcpy(out, &value, width);
+        out += width;
+    }
+
+    // Appends one column block in the encoding with the smallest bound
+    void encode(const int64_t* column) {
+        size_t sizes[ENCODINGS];
+        int width = 1;
+        measure(column, sizes, width);
+        uint8_t encoding = ENCODING_PLAIN;
+        for (uint8_t candidate = ENCODING_PLAIN + 1; candidate < ENCODINGS; candidate++) {
+            if (sizes[candidate] < sizes[encoding]) {
+                encoding = candidate;
+            }
+        }
+        size_t start = encoded.size();
+        encoded.resize(start + sizes[encoding]);
+        uint8_t* out = encoded.data() + start;
+        *out++ = encoding;
+
+        switch (encoding) {
+            case ENCODING_PLAIN:
+                *out++ = static_cast<uint8_t>(width);
+                for (size_t row = 0; row < rows; row++) {
+                    putPlain(out, column[row], width);
+                }
+                break;
+            case ENCODING_DICTIONARY: {
+                // measure() built the dictionary of this column last
+                int count = dictionary.size();
+                int bits = dictionary.codeBits();
+                *out++ = static_cast<uint8_t>(width);
+                *out++ = static_cast<uint8_t>(count);
+                *out++ = static_cast<uint8_t>(count >> 8);
+                for (int code = 0; code < count; code++) {
+                    putPlain(out, dictionary[code], width);
+                }
+                *out++ = static_cast<uint8_t>(bits);
+                // Codes are gathered in a register and stored seven bytes at a time
+                uint64_t pending = 0;
+                int pendingBits = 0;
+                for (size_t row = 0; row < rows && bits > 0; row++) {
+                    pending |= static_cast<uint64_t>(rowCodes[row]) << pendingBits;
+                    pendingBits += bits;
+                    if (pendingBits >= 56) {
+                        memcpy(out, &pending, 7);
+                        out += 7;
+                        pending >>= 56;
+                        pendingBits -= 56;
+                    }
+                }
+                for (; pendingBits > 0; pendingBits -= 8) {
+                    *out++ = static_cast<uint8_t>(pending);
+                    pending >>= 8;
+                }
+                break;
+            }
+            case ENCODING_DELTA:
+                putVarint(out, zigzag(column[0]));
+                for (size_t row = 1; row < rows; row++) {
+                    putVarint(out, zigzag(column[row] - column[row - 1]));
+                }
+                break;
+            default: {
+                int64_t runValue = 0;
+                size_t runStart = 0;
+                for (size_t row = 1; row <= rows; row++) {
+                    if (row == rows || column[row] != column[runStart]) {
+                        putVarint(out, zigzag(column[runStart] - runValue));
+                        putVarint(out, row - runStart);
+                        runValue = column[runStart];
+                        runStart = row;
+                    }
+                }
+                break;
+            }
+        }
+        assert(out <= encoded.data() + encoded.size());
+        encoded.resize(out - encoded.data());
+    }
+
+public:
+    // Constructor: makes room for the given number of rounds, so adding them does not allocate
+    explicit ExportChunk(size_t expectedRounds)
+        : values(std::max<size_t>(expectedRounds, 1) * EXPORT_COLUMNS), capacity(std::max<size_t>(expectedRounds, 1)),
+          rowCodes(capacity) {
+        encoded.reserve(expectedRounds * 8);
+    }
+
+    // Adds one round as a row
+    void add(float bet, int playerTotal, int dealerTotal, int outcome, float payout, float balance, int level) {
+        if (rows == capacity) {
+            grow();
+        }
+        int64_t* row = values.data() + rows++;
+        row[EXPORT_BET * capacity] = cents(bet);
+        row[EXPORT_PLAYER_TOTAL * capacity] = playerTotal;
+        row[EXPORT_DEALER_TOTAL * capacity] = dealerTotal;
+        row[EXPORT_OUTCOME * capacity] = outcome;
+        row[EXPORT_PAYOUT * capacity] = cents(payout);
+        row[EXPORT_BALANCE * capacity] = cents(balance);
+        row[EXPORT_LEVEL * capacity] = level;
+    }
+
+    // Encodes every column; the chunk is then ready to be written. The chunk starts with the offset
+    // of each column block (and of its end), so a reader can go straight to the columns it wants.
+    void finish() {
+        uint32_t offsets[EXPORT_COLUMNS + 1] = {};
+        encoded.assign(sizeof(offsets), 0);
+        for (int column = 0; column < EXPORT_COLUMNS; column++) {
+            offsets[column] = static_cast<uint32_t>(encoded.size());
+            if (rows > 0) {
+                encode(values.data() + column * capacity);
+            }
+        }
+        offsets[EXPORT_COLUMNS] = static_cast<uint32_t>(encoded.size());
+        memcpy(encoded.data(), offsets, sizeof(offsets));
+    }
+
+    // Starts a new chunk in the same memory
+    void clear() {
+        rows = 0;
+        encoded.clear();
+    }
+
+    uint32_t getRounds() const {
+        return static_cast<uint32_t>(rows);
+    }
+
+    const uint8_t* getData() const {
+        return encoded.data();
+    }
+
+    size_t getSize() const {
+        return encoded.size();
+    }
+};
+
+// Decodes a column block of the given number of rows into values; returns false if it is damaged
+inline bool decodeColumn(const uint8_t* data, size_t bytes, uint32_t rows, int64_t* values) {
+    const uint8_t* end = data + bytes;
+    if (rows == 0) {
+        return true;
+    }
+    if (bytes == 0) {
+        return false;
+    }
+    uint8_t encoding = *data++;
+    switch (encoding) {
+        case ENCODING_PLAIN: {
+            int width = data < end ? *data++ : 0;
+            if ((width != 1 && width != 2 && width != 4 && width != 8) || static_cast<size_t>(end - data) < rows * size_t(width)) {
+                return false;
+            }
+            for (uint32_t row = 0; row < rows; row++, data += width) {
+                values[row] = getPlain(data, width);
+            }
+            return true;
+        }
+        case ENCODING_DICTIONARY: {
+            if (end - data < 3) {
+                return false;
+            }
+            int width = data[0];
+            int count = data[1] | (data[2] << 8);
+            data += 3;
+            if ((width != 1 && width != 2 && width != 4 && width != 8) || count < 1 || count > EXPORT_DICTIONARY_SIZE
+                || end - data < static_cast<ptrdiff_t>(count) * width + 1) {
+                return false;
+            }
+            int64_t dictionary[EXPORT_DICTIONARY_SIZE];
+            for (int code = 0; code < count; code++, data += width) {
+                dictionary[code] = getPlain(data, width);
+            }
+            int bits = *data++;
+            if (bits > 8 || static_cast<size_t>(end - data) < (size_t(rows) * bits + 7) / 8) {
+                return false;
+            }
+            uint64_t pending = 0;
+            int pendingBits = 0;
+            for (uint32_t row = 0; row < rows; row++) {
+                if (pendingBits < bits) {
+                    pending |= static_cast<uint64_t>(*data++) << pendingBits;
+                    pendingBits += 8;
+                }
+                int code = static_cast<int>(pending & ((1u << bits) - 1));
+                pending >>= bits;
+                pendingBits -= bits;
+                if (code >= count) {
+                    return false;
+                }
+                values[row] = dictionary[code];
+            }
+            return true;
+        }
+        case ENCODING_DELTA: {
+            int64_t value = 0;
+            for (uint32_t row = 0; row < rows; row++) {
+                uint64_t delta;
+                if (!getVarint(data, end, delta)) {
+                    return false;
+                }
+                value += unzigzag(delta);
+                values[row] = value;
+            }
+            return true;
+        }
+        case ENCODING_RUNS: {
+            int64_t value = 0;
+            for (uint32_t row = 0; row < rows; ) {
+                uint64_t delta;
+                uint64_t length;
+                if (!getVarint(data, end, delta) || !getVarint(data, end, length) || length == 0 || length > rows - row) {
+                    return false;
+                }
+                value += unzigzag(delta);
+                for (uint64_t i = 0; i < length; i++) {
+                    values[row++] = value;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// An export being written; see ChunkFile
+class ExportFile : public ChunkFile {
+public:
+    // Constructor: creates (or replaces) the export file at the given path
+    explicit ExportFile(const std::string& filename) : ChunkFile(filename, EXPORT_MAGIC, EXPORT_VERSION) {}
+
+    // Writes a finished chunk as the given chunk number, in chunk order
+    void commit(long long index, const ExportChunk& chunk) {
+        ChunkFile::commit(index, chunk.getRounds(), chunk.getData(), chunk.getSize());
+    }
+};
+
+// One column of one chunk, as handed to a scan
+struct ColumnBlock {
+    const int64_t* values;  // The decoded values, valid until the scan moves on
+    uint32_t rounds;
+    uint8_t encoding;       // ColumnEncoding the block was stored in
+    size_t bytes;           // Size of the block in the file
+};
+
+// An export mapped into memory. A scan of a column decodes only that column's block of each chunk,
+// one chunk at a time into the same buffer, so it touches only the pages that column lives in and
+// its memory does not grow with the length of the run.
+class ExportReader {
+private:
+    ChunkFileReader file;
+
+public:
+    explicit ExportReader(const std::string& filename) : file(filename, EXPORT_MAGIC, EXPORT_VERSION) {}
+
+    bool isValid() const {
+        return file.isValid();
+    }
+
+    // Decodes the column chunk by chunk in file order and passes each block to visit(block). Stops at
+    // a damaged chunk. Returns the number of rounds visited.
+    template <typename Visit>
+    long long scan(int column, Visit visit) const {
+        std::vector<int64_t> values;
+        long long visited = 0;
+        bool intact = column >= 0 && column < EXPORT_COLUMNS;
+        file.forEachChunk([&](const uint8_t* data, size_t bytes, uint32_t rounds) {
+            uint32_t offsets[EXPORT_COLUMNS + 1];
+            intact = intact && bytes >= sizeof(offsets);
+            if (!intact) {
+                return;
+            }
+            memcpy(offsets, data, sizeof(offsets));
+            intact = offsets[column] <= offsets[column + 1] && offsets[column + 1] <= bytes;
+            values.resize(rounds);
+            size_t blockBytes = intact ? offsets[column + 1] - offsets[column] : 0;
+            intact = intact && decodeColumn(data + offsets[column], blockBytes, rounds, values.data());
+            if (intact) {
+                ColumnBlock block = {values.data(), rounds, blockBytes > 0 ? data[offsets[column]] : uint8_t(ENCODING_PLAIN),
+                                     blockBytes};
+                visit(block);
+                visited += rounds;
+            }
+        });
+        return visited;
+    }
+};
+
+#endif /* COLUMNS_H */
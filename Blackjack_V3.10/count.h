@@ -0,0 +1,68 @@
+/*
+ * File:   count.h
+ *
+ * Purpose: Card-counting systems and a running/true count kept up to date as the shoe is dealt.
+ */
+
+#ifndef COUNT_H
+#define COUNT_H
+
+#include <cstring>
+
+// A counting system: one tag per rank (0 = Ace, 12 = King) added to the running count as the card
+// is seen. Unbalanced systems start below zero so that their running count can be used as it is.
+struct CountingSystem {
+    const char* name;
+    signed char tags[13];
+    int startPerExtraDeck;  // Initial running count for each deck after the first
+};
+
+//                                   A   2   3   4   5   6   7   8   9  10   J   Q   K
+const CountingSystem HI_LO      = {"hi-lo",    {-1, +1, +1, +1, +1, +1,  0,  0,  0, -1, -1, -1, -1},  0};
+const CountingSystem KNOCK_OUT  = {"ko",       {-1, +1, +1, +1, +1, +1, +1,  0,  0, -1, -1, -1, -1}, -4};
+const CountingSystem HI_OPT_I   = {"hi-opt-1", { 0,  0, +1, +1, +1, +1,  0,  0,  0, -1, -1, -1, -1},  0};
+const CountingSystem OMEGA_II   = {"omega-2",  { 0, +1, +1, +2, +2, +2, +1,  0, -1, -2, -2, -2, -2},  0};
+const CountingSystem ZEN        = {"zen",      {-1, +1, +1, +2, +2, +2, +1,  0,  0, -2, -2, -2, -2},  0};
+
+const CountingSystem* const COUNTING_SYSTEMS[] = {&HI_LO, &KNOCK_OUT, &HI_OPT_I, &OMEGA_II, &ZEN};
+
+// Looks up a counting system by name; unknown names get Hi-Lo
+inline const CountingSystem& findCountingSystem(const char* name) {
+    for (const CountingSystem* system : COUNTING_SYSTEMS) {
+        if (strcmp(system->name, name) == 0) {
+            return *system;
+        }
+    }
+    return HI_LO;
+}
+
+// Running count over every card dealt from the shoe since the last shuffle. Each card costs one
+// table lookup and an add; the true count divides by the decks left, which the shoe already tracks.
+class CardCounter {
+private:
+    const CountingSystem* system;
+    int start;    // Running count of a freshly shuffled shoe
+    int running;  // Sum of the tags of every card seen since the shuffle
+
+public:
+    // Constructor: counts a shoe of the given number of decks with the given system
+    CardCounter(const CountingSystem& countingSystem = HI_LO, int decks = 1)
+        : system(&countingSystem), start(countingSystem.startPerExtraDeck * (decks - 1)), running(start) {}
+
+    // Starts over for a freshly shuffled shoe
+    void reset() {
+        running = start;
+    }
+
+    // Adds a dealt card of the given rank to the count
+    void see(int rank) {
+        running += system->tags[rank];
+    }
+
+    // Running count per deck left in the shoe
+    double trueCount(int cardsRemaining) const {
+        return cardsRemaining > 0 ? running * 52.0 / cardsRemaining : 0.0;
+    }
+};
+
+#endif /* COUNT_H */
@@ -0,0 +1,82 @@
+/*
+ * File:   dealer.h
+ *
+ * Purpose: Precomputed transition table for the dealer's fixed drawing rule.
+ */
+
+#ifndef DEALER_H
+#define DEALER_H
+
+// The dealer draws until their total is at least 17 and stands on soft 17
+const int DEALER_STAND_TOTAL = 17;
+
+// Where the dealer's hand goes after drawing a card
+struct DealerTransition {
+    unsigned char hardTotal;  // Total with every Ace counted as 1
+    bool soft;                // Whether an Ace now counts as 11
+    bool stand;               // Whether the dealer stops drawing (includes busting)
+    bool bust;                // Whether the dealer went over 21
+
+    // Best total of the new state
+    constexpr int total() const {
+        return soft ? hardTotal + 10 : hardTotal;
+    }
+};
+
+// Dealer automaton: the state is (hard total, soft flag) and every draw is one lookup indexed by
+// (hard total, soft flag, card rank). A soft Ace that would bust is demoted to 1 by the table itself,
+// so playing out the dealer's hand never walks over the cards.
+class DealerTable {
+public:
+    static const int MAX_HARD_TOTAL = 21;
+
+private:
+    DealerTransition transitions[MAX_HARD_TOTAL + 1][2][13] = {};
+
+public:
+    // Constructor: fills the table for a dealer who stands once their total reaches standTotal
+    constexpr DealerTable(int standTotal = DEALER_STAND_TOTAL) {
+        for (int hard = 0; hard <= MAX_HARD_TOTAL; hard++) {
+            for (int soft = 0; soft < 2; soft++) {
+                for (int rank = 0; rank < 13; rank++) {
+                    int value = rank >= 9 ? 10 : rank + 1;
+                    int nextHard = hard + value;
+                    bool nextSoft = (soft || rank == 0) && nextHard + 10 <= 21;
+                    bool bust = nextHard > 21;
+                    int nextTotal = nextSoft ? nextHard + 10 : nextHard;
+
+                    DealerTransition& transition = transitions[hard][soft][rank];
+                    transition.hardTotal = static_cast<unsigned char>(nextHard);
+                    transition.soft = nextSoft;
+                    transition.bust = bust;
+                    transition.stand = bust || nextTotal >= standTotal;
+                }
+            }
+        }
+    }
+
+    // Looks up the state after drawing a card of the given rank (0 = Ace, 12 = King)
+    constexpr const DealerTransition& next(int hardTotal, bool soft, int rank) const {
+        return transitions[hardTotal][soft][rank];
+    }
+
+    // The state before the dealer's first card
+    static constexpr DealerTransition start() {
+        return DealerTransition{0, false, false, false};
+    }
+};
+
+// Table for this game's dealer rule, built at compile time
+constexpr DealerTable DEALER_TABLE(DEALER_STAND_TOTAL);
+
+// Checks of the table the compiler makes instead of the game checking every dealer hand: an Ace is
+// counted as 11 when it fits, a soft hand that would bust counts it as 1 again, the dealer stands on
+// soft 17 and draws to soft 16
+static_assert(DEALER_TABLE.next(0, false, 0).total() == 11 && DEALER_TABLE.next(0, false, 0).soft, "Ace counts as 11");
+static_assert(DEALER_TABLE.next(6, true, 9).total() == 16 && !DEALER_TABLE.next(6, true, 9).soft, "soft 16 + 10 is hard 16");
+static_assert(!DEALER_TABLE.next(6, true, 9).stand, "dealer draws to hard 16");
+static_assert(DEALER_TABLE.next(6, false, 0).total() == 17 && DEALER_TABLE.next(6, false, 0).stand, "dealer stands on soft 17");
+static_assert(!DEALER_TABLE.next(5, false, 0).stand, "dealer draws to soft 16");
+static_assert(DEALER_TABLE.next(12, false, 9).bust && DEALER_TABLE.next(12, false, 9).stand, "hard 22 is a bust");
+
+#endif /* DEALER_H */
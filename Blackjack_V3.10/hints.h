@@ -0,0 +1,148 @@
+/*
+ * File:   hints.h
+ *
+ * Purpose: Background thread that works out the expected value of every action while
+ *          the game waits for the player to type a decision.
+ */
+
+#ifndef HINTS_H
+#define HINTS_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "odds.h"
+
+// Solved values for one player decision
+struct HintEntry {
+    uint64_t composition;  // Packed cards left in the shoe
+    int total;
+    bool soft;
+    ActionValues values;
+};
+
+// Speculatively solves the decision on screen and, after it, the decision that follows each card
+// a hit could draw. The work runs on its own thread while the console blocks on input; it is
+// cancelled between two evaluations once the player answers, so it never delays the game.
+// Solved entries are kept until the next start(), so the decision after a hit is usually ready
+// before the new cards are even printed.
+class HintWorker {
+private:
+    EVCalculator calculator;        // Only used by the worker thread, or while no thread runs
+    std::thread worker;
+    std::atomic<bool> cancelled;
+    std::mutex mutex;
+    std::condition_variable solved;
+    std::vector<HintEntry> entries; // entries[0] is the current decision once currentReady is set
+    HintEntry current;
+    bool currentReady = false;
+    bool finished = true;
+    bool running = false;
+
+    // Solves the current decision first, then the decisions after each possible hit
+    void run(ShoeComposition shoe, int total, bool soft) {
+        if (!currentReady) {
+            ActionValues values = calculator.evaluate(shoe, total, soft);
+            std::lock_guard<std::mutex> lock(mutex);
+            current.values = values;
+            entries.push_back(current);
+            currentReady = true;
+            solved.notify_all();
+        }
+
+        int hardTotal = soft ? total - 10 : total;
+        for (int card = 0; card < CARD_VALUES && !cancelled.load(std::memory_order_relaxed); card++) {
+            const DealerTransition& next = DEALER_TABLE.next(hardTotal, soft, card);
+            if (shoe.counts[card] == 0 || next.bust || next.total() == 21) {
+                continue;
+            }
+            shoe.remove(card);
+            HintEntry entry = {shoe.pack(), next.total(), next.soft, calculator.evaluate(shoe, next.total(), next.soft)};
+            shoe.add(card);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.push_back(entry);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        solved.notify_all();
+    }
+
+public:
+    // Constructor: values are solved for the given payouts
+    explicit HintWorker(const PayoutRules& rules = PayoutRules()) : calculator(rules), cancelled(false) {}
+
+    ~HintWorker() {
+        cancel();
+    }
+
+    // Starts solving the decision for a hand with the given cards left in the shoe. Does nothing if
+    // that decision is already being solved; otherwise stops the previous work first.
+    void start(const ShoeComposition& shoe, int total, bool soft, float betMultiplier) {
+        if (total >= 21) {
+            cancel();
+            currentReady = false;
+            return;
+        }
+        uint64_t composition = shoe.pack();
+        if (running && !cancelled && current.composition == composition && current.total == total
+            && current.soft == soft && calculator.getRules().betMultiplier == betMultiplier) {
+            return;
+        }
+        cancel();
+
+        if (calculator.getRules().betMultiplier != betMultiplier) {
+            PayoutRules rules = calculator.getRules();
+            rules.betMultiplier = betMultiplier;
+            calculator.setRules(rules);
+            entries.clear();
+        }
+
+        // Reuse the entry if the last run already solved this decision
+        current = {composition, total, soft, ActionValues()};
+        currentReady = false;
+        for (const HintEntry& entry : entries) {
+            if (entry.composition == composition && entry.total == total && entry.soft == soft) {
+                current.values = entry.values;
+                currentReady = true;
+                break;
+            }
+        }
+        entries.clear();
+        if (currentReady) {
+            entries.push_back(current);
+        }
+
+        cancelled = false;
+        finished = false;
+        running = true;
+        worker = std::thread(&HintWorker::run, this, shoe, total, soft);
+    }
+
+    // Stops the worker between two evaluations and waits for it to exit
+    void cancel() {
+        cancelled = true;
+        if (worker.joinable()) {
+            worker.join();
+        }
+        running = false;
+    }
+
+    // Waits until the current decision is solved and returns its values.
+    // Returns false if no decision was started or it was cancelled before being solved.
+    bool values(ActionValues& values) {
+        std::unique_lock<std::mutex> lock(mutex);
+        solved.wait(lock, [this] { return currentReady || finished; });
+        if (!currentReady) {
+            return false;
+        }
+        values = current.values;
+        return true;
+    }
+};
+
+#endif /* HINTS_H */
@@ -0,0 +1,484 @@
+/*
+ * File:   history.h
+ *
+ * Purpose: Compact hand history: every round is encoded as a bitstream of about fifty bits,
+ *          grouped in chunks that are written in order to one file and read back by mapping it.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "chunk_file.h"
+
+const uint32_t HISTORY_MAGIC = 0x48504a42;  // "BJPH" in a little-endian file
+const uint16_t HISTORY_VERSION = 2;
+const uint32_t SITUATION_MAGIC = 0x49534a42;  // "BJSI": the situation index next to a history
+
+// Most cards a hand in the history can hold, as many as Hand::MAX_CARDS
+const int HISTORY_MAX_CARDS = 21;
+
+// One round as the history sees it. Cards are indexes 0-51 as in Card; the hands are only pointed
+// to, so recording a round copies nothing.
+struct HistoryRound {
+    const uint8_t* playerCards = nullptr;
+    const uint8_t* dealerCards = nullptr;
+    int playerCount = 0;
+    int dealerCount = 0;  // 0 when the round was settled before the dealer played
+    uint8_t upcard = 0;   // The dealer's first card; in a round settled before the dealer played,
+                          // the card the dealer would have been dealt first
+    bool doubledDown = false;
+    bool stood = false;   // Whether the player's turn ended with a stand
+    int outcome = 0;      // RoundOutcome
+    int xpAwarded = 0;
+    float bet = 0.0f;     // Total stake, doubled by a double down
+};
+
+// Bit layout of a round, least significant bit first:
+//   bet            1 bit: 0 = same as the round before in the chunk, 1 = followed by the 32-bit float
+//   first 2 cards  6 bits each
+//   actions        a prefix code, each followed by the card it drew where it drew one:
+//                  0 stand | 10 hit + card | 110 double down + card | 111 turn over without a decision
+//   dealer         4-bit card count, then 6 bits per card; a count of 0 (the round was settled before
+//                  the dealer played) is followed by the card the dealer would have been dealt first
+//   outcome        4 bits
+//   XP awarded     zigzag encoded, in groups of 4 bits that each start with a bit saying another follows
+// A typical round takes about 50 bits, so a billion rounds fit in well under 10 GB.
+const int HISTORY_CARD_BITS = 6;
+
+// Number of values of RoundOutcome
+const int HISTORY_OUTCOMES = 9;
+
+// A situation is the state of the player's hand at a decision and the decision taken there, keyed
+// as action | upcard << 2 | soft << 6 | total << 7. The player decides before the dealer draws in
+// this game, so the "upcard" is the value, 1 (Ace) to 10, of the dealer's first card. Rounds the
+// player busted or won with 21 have one too: the card the dealer would have been dealt first.
+enum SituationAction {
+    SITUATION_HIT = 0,
+    SITUATION_STAND = 1,
+    SITUATION_DOUBLE = 2,
+    SITUATION_ACTIONS = 3
+};
+
+const int SITUATION_KEYS = 1 << 12;
+
+inline int situationKey(int total, bool soft, int upcard, int action) {
+    return action | upcard << 2 | static_cast<int>(soft) << 6 | total << 7;
+}
+
+// Passes the key of every decision the player made in a round to visit(key), in order: a double
+// down, or a hit for every card after the first two and then a stand if the turn ended with one
+template <typename Visit>
+void forEachDecision(const HistoryRound& round, Visit visit) {
+    int hardTotal = 0;
+    int aces = 0;
+    auto add = [&](uint8_t card) {
+        int rank = card % 13;
+        hardTotal += rank >= 9 ? 10 : rank + 1;
+        aces += rank == 0;
+    };
+    int upcardRank = round.upcard % 13;
+    int upcard = upcardRank >= 9 ? 10 : upcardRank + 1;
+    auto key = [&](int action) {
+        bool soft = aces > 0 && hardTotal + 10 <= 21;
+        return situationKey(soft ? hardTotal + 10 : hardTotal, soft, upcard, action);
+    };
+
+    add(round.playerCards[0]);
+    add(round.playerCards[1]);
+    if (round.doubledDown) {
+        visit(key(SITUATION_DOUBLE));
+        return;
+    }
+    for (int card = 2; card < round.playerCount; card++) {
+        visit(key(SITUATION_HIT));
+        add(round.playerCards[card]);
+    }
+    if (round.stood) {
+        visit(key(SITUATION_STAND));
+    }
+}
+
+// Outcomes of the rounds in which one situation came up in one chunk, as stored in the index
+struct SituationEntry {
+    uint16_t key;
+    uint16_t reserved;
+    uint32_t outcomes[HISTORY_OUTCOMES];  // Decisions in the situation, by the outcome of their round
+};
+
+static_assert(sizeof(SituationEntry) == 40, "SituationEntry is an on-disk format and must not change size");
+
+// Counts of every situation and outcome in a chunk, updated as each round is recorded. finish()
+// turns them into the entries of the situations that came up, which is the chunk's index.
+class SituationTally {
+private:
+    std::vector<uint32_t> counts;         // SITUATION_KEYS rows of HISTORY_OUTCOMES counts
+    std::vector<SituationEntry> entries;
+
+public:
+    SituationTally() : counts(SITUATION_KEYS * HISTORY_OUTCOMES) {}
+
+    // Counts the decisions of a round under its outcome
+    void add(const HistoryRound& round) {
+        if (round.outcome < 0 || round.outcome >= HISTORY_OUTCOMES) {
+            return;
+        }
+        forEachDecision(round, [&](int key) {
+            counts[key * HISTORY_OUTCOMES + round.outcome]++;
+        });
+    }
+
+    // Lists the situations that came up, in key order
+    void finish() {
+        entries.clear();
+        for (int key = 0; key < SITUATION_KEYS; key++) {
+            const uint32_t* row = counts.data() + key * HISTORY_OUTCOMES;
+            uint32_t total = 0;
+            for (int outcome = 0; outcome < HISTORY_OUTCOMES; outcome++) {
+                total |= row[outcome];
+            }
+            if (total != 0) {
+                SituationEntry entry = {static_cast<uint16_t>(key), 0, {}};
+                memcpy(entry.outcomes, row, sizeof(entry.outcomes));
+                entries.push_back(entry);
+            }
+        }
+    }
+
+    // Starts a new chunk in the same memory
+    void clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        entries.clear();
+    }
+
+    const uint8_t* getData() const {
+        return reinterpret_cast<const uint8_t*>(entries.data());
+    }
+
+    size_t getSize() const {
+        return entries.size() * sizeof(SituationEntry);
+    }
+};
+
+// Writes bits least significant first into a growing byte buffer. Every put stores the pending
+// bits as one unaligned 64-bit word and moves on by the whole bytes in it, so there is no branch;
+// callers make room for a whole round at a time with reserve().
+class BitWriter {
+private:
+    std::vector<uint8_t> buffer;  // Storage, with at least 8 bytes to spare after the written ones
+    size_t used = 0;              // Bytes that are complete
+    uint64_t pending = 0;         // Bits after them, fewer than 8
+    int pendingCount = 0;
+
+public:
+    // Makes sure the next puts have room for the given number of bytes
+    void reserve(size_t bytes) {
+        if (used + bytes + 8 > buffer.size()) {
+            buffer.resize(std::max(buffer.size() * 2, used + bytes + 8));
+        }
+    }
+
+    // Appends the low count bits of value (count at most 56)
+    void put(uint64_t value, int count) {
+        pending |= value << pendingCount;
+        pendingCount += count;
+        memcpy(buffer.data() + used, &pending, 8);
+        used += pendingCount >> 3;
+        pending >>= pendingCount & ~7;
+        pendingCount &= 7;
+    }
+
+    // Counts the last partial byte, padded with zeros, as written
+    void finish() {
+        used += pendingCount > 0;
+        pending = 0;
+        pendingCount = 0;
+    }
+
+    // Empties the buffer but keeps its memory
+    void clear() {
+        used = 0;
+        pending = 0;
+        pendingCount = 0;
+    }
+
+    const uint8_t* data() const {
+        return buffer.data();
+    }
+
+    size_t size() const {
+        return used;
+    }
+};
+
+// Reads bits least significant first from a byte range; reading past the end gives zeros
+class BitReader {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;  // In bits
+
+public:
+    BitReader(const uint8_t* bytes, size_t length) : data(bytes), size(length) {}
+
+    // Reads count bits (at most 57)
+    uint64_t get(int count) {
+        size_t byte = position >> 3;
+        uint64_t word = 0;
+        if (byte + 8 <= size) {
+            memcpy(&word, data + byte, 8);
+        } else if (byte < size) {
+            memcpy(&word, data + byte, size - byte);
+        }
+        position += count;
+        return (word >> ((position - count) & 7)) & ((1ull << count) - 1);
+    }
+
+    bool get() {
+        return get(1) != 0;
+    }
+};
+
+// A chunk of encoded rounds. Each chunk starts afresh, so chunks can be encoded on different
+// threads and decoded on their own.
+class HistoryChunk {
+private:
+    BitWriter writer;
+    uint32_t rounds = 0;
+    SituationTally situations;  // The chunk's index, built as rounds are added
+    float lastBet = -1.0f;
+
+public:
+    // Most bytes one round can take: a new bet and 21 cards in each hand
+    static constexpr size_t MAX_ROUND_BYTES = (33 + 2 * HISTORY_CARD_BITS + 19 * (2 + HISTORY_CARD_BITS) + 3 + 4
+                                               + HISTORY_MAX_CARDS * HISTORY_CARD_BITS + 4 + 4 * 11) / 8 + 1;
+
+    // Reserves room for the given number of typical rounds, so recording does not allocate
+    explicit HistoryChunk(size_t expectedRounds = 0) {
+        writer.reserve(expectedRounds * 8);
+    }
+
+    // Encodes a round. Its fields are gathered in a register and handed to the writer 56 bits at a
+    // time, which for most rounds means once.
+    void add(const HistoryRound& round) {
+        writer.reserve(MAX_ROUND_BYTES);
+        uint64_t bits = 0;
+        int count = 0;
+        auto append = [&](uint64_t value, int width) {
+            if (count + width > 56) {
+                writer.put(bits, count);
+                bits = 0;
+                count = 0;
+            }
+            bits |= value << count;
+            count += width;
+        };
+
+        if (round.bet == lastBet) {
+            append(0, 1);
+        } else {
+            uint32_t betBits;
+            memcpy(&betBits, &round.bet, sizeof(betBits));
+            append(1 | static_cast<uint64_t>(betBits) << 1, 33);
+            lastBet = round.bet;
+        }
+        append(round.playerCards[0] | round.playerCards[1] << HISTORY_CARD_BITS, 2 * HISTORY_CARD_BITS);
+
+        if (round.doubledDown) {
+            append(0x3 | round.playerCards[2] << 3, 3 + HISTORY_CARD_BITS);
+        } else {
+            for (int card = 2; card < round.playerCount; card++) {
+                append(0x1 | round.playerCards[card] << 2, 2 + HISTORY_CARD_BITS);
+            }
+            append(round.stood ? 0x0 : 0x7, round.stood ? 1 : 3);
+        }
+
+        append(round.dealerCount, 4);
+        for (int card = 0; card < round.dealerCount; card++) {
+            append(round.dealerCards[card], HISTORY_CARD_BITS);
+        }
+        if (round.dealerCount == 0) {
+            append(round.upcard, HISTORY_CARD_BITS);
+        }
+        append(round.outcome, 4);
+
+        uint32_t zigzag = (static_cast<uint32_t>(round.xpAwarded) << 1) ^ static_cast<uint32_t>(round.xpAwarded >> 31);
+        do {
+            uint32_t group = zigzag & 0x7;
+            zigzag >>= 3;
+            append(group << 1 | (zigzag != 0), 4);
+        } while (zigzag != 0);
+        writer.put(bits, count);
+        rounds++;
+        situations.add(round);
+    }
+
+    // Pads the last byte and lists the chunk's situations; the chunk is then ready to be written
+    void finish() {
+        writer.finish();
+        situations.finish();
+    }
+
+    // Starts a new chunk in the same memory
+    void clear() {
+        writer.clear();
+        situations.clear();
+        rounds = 0;
+        lastBet = -1.0f;
+    }
+
+    uint32_t getRounds() const {
+        return rounds;
+    }
+
+    const uint8_t* getData() const {
+        return writer.data();
+    }
+
+    size_t getSize() const {
+        return writer.size();
+    }
+
+    const SituationTally& getSituations() const {
+        return situations;
+    }
+};
+
+// Decodes the rounds of one chunk in order
+class HistoryChunkReader {
+private:
+    BitReader reader;
+    uint32_t remaining;
+    float lastBet = 0.0f;
+    uint8_t playerCards[HISTORY_MAX_CARDS];  // Hands of the last round decoded
+    uint8_t dealerCards[HISTORY_MAX_CARDS];
+
+public:
+    HistoryChunkReader(const uint8_t* bytes, size_t length, uint32_t rounds) : reader(bytes, length), remaining(rounds) {}
+
+    // Decodes the next round; returns false after the last one. The round's hands stay valid until
+    // the next call.
+    bool next(HistoryRound& round) {
+        if (remaining == 0) {
+            return false;
+        }
+        remaining--;
+        round.playerCards = playerCards;
+        round.dealerCards = dealerCards;
+        if (reader.get()) {
+            uint32_t betBits = static_cast<uint32_t>(reader.get(32));
+            memcpy(&lastBet, &betBits, sizeof(lastBet));
+        }
+        round.bet = lastBet;
+        playerCards[0] = static_cast<uint8_t>(reader.get(HISTORY_CARD_BITS));
+        playerCards[1] = static_cast<uint8_t>(reader.get(HISTORY_CARD_BITS));
+        round.playerCount = 2;
+        round.doubledDown = false;
+        round.stood = false;
+
+        while (true) {
+            if (!reader.get()) {
+                round.stood = true;
+                break;
+            }
+            if (!reader.get()) {
+                // Hit
+                playerCards[round.playerCount++] = static_cast<uint8_t>(reader.get(HISTORY_CARD_BITS));
+                if (round.playerCount == HISTORY_MAX_CARDS) {
+                    break;
+                }
+                continue;
+            }
+            if (!reader.get()) {
+                round.doubledDown = true;
+                playerCards[round.playerCount++] = static_cast<uint8_t>(reader.get(HISTORY_CARD_BITS));
+            }
+            break;
+        }
+
+        round.dealerCount = static_cast<int>(reader.get(4));
+        for (int card = 0; card < round.dealerCount; card++) {
+            dealerCards[card] = static_cast<uint8_t>(reader.get(HISTORY_CARD_BITS));
+        }
+        round.upcard = round.dealerCount > 0 ? dealerCards[0] : static_cast<uint8_t>(reader.get(HISTORY_CARD_BITS));
+        round.outcome = static_cast<int>(reader.get(4));
+
+        uint32_t zigzag = 0;
+        for (int shift = 0; ; shift += 3) {
+            uint32_t group = static_cast<uint32_t>(reader.get(4));
+            zigzag |= (group >> 1) << shift;
+            if ((group & 1) == 0 || shift > 28) {
+                break;
+            }
+        }
+        round.xpAwarded = static_cast<int>(zigzag >> 1) ^ -static_cast<int>(zigzag & 1);
+        return true;
+    }
+};
+
+// A history file being written; see ChunkFile. The situation index of every chunk goes to a second
+// chunk file next to it, the history's name with ".idx" added, chunk for chunk.
+class HistoryFile : public ChunkFile {
+private:
+    ChunkFile index;
+
+public:
+    // Constructor: creates (or replaces) the history file at the given path and its index
+    explicit HistoryFile(const std::string& filename)
+        : ChunkFile(filename, HISTORY_MAGIC, HISTORY_VERSION), index(filename + ".idx", SITUATION_MAGIC, HISTORY_VERSION) {}
+
+    // Writes a finished chunk and its index as the given chunk number, in chunk order
+    void commit(long long chunkIndex, const HistoryChunk& chunk) {
+        ChunkFile::commit(chunkIndex, chunk.getRounds(), chunk.getData(), chunk.getSize());
+        index.commit(chunkIndex, chunk.getRounds(), chunk.getSituations().getData(), chunk.getSituations().getSize());
+    }
+
+    // Closes the history and the index; returns false if anything could not be written
+    bool close() {
+        bool indexWritten = index.close();
+        return ChunkFile::close() && indexWritten;
+    }
+};
+
+// A history file mapped into memory, read chunk by chunk
+class HistoryReader {
+private:
+    ChunkFileReader file;
+
+public:
+    explicit HistoryReader(const std::string& filename) : file(filename, HISTORY_MAGIC, HISTORY_VERSION) {
+        file.advise(MADV_SEQUENTIAL);
+    }
+
+    bool isValid() const {
+        return file.isValid();
+    }
+
+    // Passes every chunk to visit(data, bytes, rounds) in file order, for HistoryChunkReader
+    template <typename Visit>
+    long long forEachChunk(Visit visit) const {
+        return file.forEachChunk(visit);
+    }
+
+    // Decodes every round in file order and passes it to visit(round). Stops at a chunk cut short,
+    // as a file still being written can end with one. Returns the number of rounds visited.
+    template <typename Visit>
+    long long forEach(Visit visit) const {
+        long long visited = 0;
+        HistoryRound round;
+        file.forEachChunk([&](const uint8_t* data, size_t bytes, uint32_t rounds) {
+            HistoryChunkReader chunk(data, bytes, rounds);
+            while (chunk.next(round)) {
+                visit(round);
+                visited++;
+            }
+        });
+        return visited;
+    }
+};
+
+#endif /* HISTORY_H */
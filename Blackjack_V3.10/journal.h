@@ -0,0 +1,172 @@
+/*
+ * File:   journal.h
+ *
+ * Purpose: Append-only journal of everything that changes the player's profile: every settled
+ *          round, shop purchase and reset. The profile record is only a snapshot of the journal,
+ *          so the rounds played since the last snapshot are replayed from here on startup. Once a
+ *          snapshot covering the whole journal is on the disk, the journal is emptied again.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "profile.h"
+
+// Kinds of journal entries
+enum JournalKind : uint8_t {
+    JOURNAL_ROUND = 1,     // A settled round
+    JOURNAL_PURCHASE = 2,  // A shop purchase
+    JOURNAL_RESET = 3      // The profile was reset to a new player's
+};
+
+// Bits of JournalEntry::actions. The player's decisions follow from them and the cards: a double
+// down draws one card; otherwise every card after the first two was a hit, then a stand if flagged.
+const uint8_t JOURNAL_DOUBLED_DOWN = 1;
+const uint8_t JOURNAL_STOOD = 2;
+
+// Number of card indexes (0-51) an entry can hold, the player's first and then the dealer's
+const int JOURNAL_CARDS = 27;
+
+// One journal entry on disk. Like ProfileRecord every field has a fixed size and offset, and the
+// checksum tells a complete entry from the torn tail of a write that was interrupted.
+struct JournalEntry {
+    uint32_t sequence = 0;      // One more than the entry before it; the first entry is 1
+    float bet = 0.0f;           // Rounds: total stake, doubled by a double down
+    float balanceChange = 0.0f; // Net change of the balance: the round's payout, or a purchase's price
+    float balance = 0.0f;       // Balance after the entry
+    int32_t xpAwarded = 0;      // Rounds: XP passed to ExperienceLevel::gainExperience
+    float xpMultiplier = 1.0f;  // Multipliers after the entry
+    float betMultiplier = 1.0f;
+    uint8_t kind = JOURNAL_ROUND;
+    uint8_t outcome = 0;        // Rounds: the RoundOutcome
+    uint8_t actions = 0;        // Rounds: JOURNAL_DOUBLED_DOWN | JOURNAL_STOOD
+    uint8_t playerCardCount = 0;
+    uint8_t dealerCardCount = 0;
+    uint8_t cards[JOURNAL_CARDS] = {};
+    uint32_t checksum = 0;      // FNV-1a of every byte before it
+};
+
+static_assert(sizeof(JournalEntry) == 64, "JournalEntry is an on-disk format and must not change size");
+static_assert(offsetof(JournalEntry, checksum) == 60, "checksum must cover every other byte");
+
+// Checksum of an entry, covering every byte before the checksum field
+inline uint32_t journalChecksum(const JournalEntry& entry) {
+    return fnv1a(&entry, offsetof(JournalEntry, checksum));
+}
+
+// The journal file. Each entry is appended with a single write of 64 bytes, which is much cheaper
+// than rewriting the profile and cannot damage anything already in the file. Opening it scans the
+// entries and cuts off a torn or damaged tail, so new entries always follow the last intact one.
+class RoundJournal {
+private:
+    std::string path;
+    int descriptor;
+    uint32_t sequence;  // Sequence number of the last entry in the journal
+    off_t length;       // Length of the intact entries, where the next one is written
+
+public:
+    // Constructor: opens (or creates) the journal file at the given path
+    explicit RoundJournal(const std::string& filename)
+        : path(filename), descriptor(open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_BINARY, 0644)),
+          sequence(0), length(0) {}
+
+    ~RoundJournal() {
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+    }
+
+    RoundJournal(const RoundJournal&) = delete;
+    RoundJournal& operator=(const RoundJournal&) = delete;
+
+    // Reads the journal from the start and passes every entry after the given sequence number to
+    // apply(entry), in order. Reading stops at the first entry that is incomplete, damaged or not
+    // numbered after the one before it, and the file is truncated there. Numbers can skip ahead:
+    // when the journal lost entries that a snapshot already covers, new ones continue the snapshot's
+    // numbering. Returns the number of entries applied.
+    template <typename Apply>
+    long long replay(uint32_t after, Apply apply) {
+        const int BATCH = 64;
+        JournalEntry entries[BATCH];
+        long long applied = 0;
+        off_t offset = 0;
+        uint32_t last = 0;
+        bool intact = descriptor >= 0;
+        while (intact) {
+            ssize_t bytes = pread(descriptor, entries, sizeof(entries), offset);
+            int count = bytes > 0 ? static_cast<int>(bytes / sizeof(JournalEntry)) : 0;
+            for (int i = 0; i < count && intact; i++) {
+                intact = entries[i].sequence > last && entries[i].checksum == journalChecksum(entries[i]);
+                if (intact) {
+                    last = entries[i].sequence;
+                    offset += sizeof(JournalEntry);
+                    if (last > after) {
+                        apply(entries[i]);
+                        applied++;
+                    }
+                }
+            }
+            intact = intact && count == BATCH;
+        }
+        if (descriptor >= 0 && ftruncate(descriptor, offset) != 0) {
+            close(descriptor);
+            descriptor = -1;
+        }
+
+        // A snapshot newer than the journal (the journal was lost) keeps its numbering
+        sequence = last > after ? last : after;
+        length = offset;
+        return applied;
+    }
+
+    // Numbers an entry, checksums it and appends it in one system call. A write that only got
+    // part of the entry out is cut off again, so it cannot hide the entries appended after it.
+    bool append(JournalEntry entry) {
+        if (descriptor < 0) {
+            return false;
+        }
+        entry.sequence = sequence + 1;
+        entry.checksum = journalChecksum(entry);
+        if (write(descriptor, &entry, sizeof(entry)) != static_cast<ssize_t>(sizeof(entry))) {
+            if (ftruncate(descriptor, length) != 0) {
+                close(descriptor);
+                descriptor = -1;
+            }
+            return false;
+        }
+        sequence = entry.sequence;
+        length += sizeof(entry);
+        return true;
+    }
+
+    // Empties the journal. Only call this once a snapshot covering every entry is on the disk; the
+    // entries appended after it continue the numbering, so replay() still applies exactly those.
+    bool truncate() {
+        if (descriptor < 0 || ftruncate(descriptor, 0) != 0) {
+            return false;
+        }
+        length = 0;
+        return true;
+    }
+
+    // Waits until every appended entry is on the disk
+    bool sync() {
+        return descriptor >= 0 && fsync(descriptor) == 0;
+    }
+
+    // Sequence number of the last entry, which a snapshot taken now covers
+    uint32_t getSequence() const {
+        return sequence;
+    }
+
+    const std::string& getPath() const {
+        return path;
+    }
+};
+
+#endif /* JOURNAL_H */
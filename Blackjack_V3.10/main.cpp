@@ -15,83 +15,323 @@
 #include <ctime>
 #include <vector>
 #include <algorithm> 
-#include <set> 
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cmath>
+#include <cctype>
+
+//User Libraries
+#include "random.h"
+#include "dealer.h"
+#include "odds.h"
+#include "strategy_table.h"
+#include "hints.h"
+#include "count.h"
+#include "xp_model.h"
+#include "profile.h"
+#include "journal.h"
+#include "profile_table.h"
+#include "profile_batch.h"
+#include "history.h"
+#include "columns.h"
+#include "situations.h"
 
 using namespace std;
 
-// Class representing a playing card with a rank and suit
+// Number of heap allocations made by the current thread. The simulator reads it before and after
+// playing rounds to check that steady-state play never touches the heap. It is only counted in
+// builds with -DCOUNT_ALLOCATIONS, so the game itself allocates through the standard functions.
+thread_local unsigned long long heapAllocations = 0;
+
+#ifdef COUNT_ALLOCATIONS
+// Global allocation functions that count every allocation. They are kept out of line so GCC does
+// not pair the malloc and free inside them with inlined new/delete calls and warn about a mismatch.
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void* operator new(size_t size) {
+    heapAllocations++;
+    if (void* memory = malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+NOINLINE void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+NOINLINE void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+#endif /* COUNT_ALLOCATIONS */
+
+// Class representing a playing card with a rank and suit, packed into a single byte
 class Card {
 protected:
-    int rank;     // Numeric value representing the card's rank (0-12)
-    string suit;  // String representing the card's suit (♥, ♦, ♣, ♠)
+    unsigned char index;  // Card index (0-51): rank is index % 13 (0-12), suit is index / 13 (0-3)
 
 public:
-    // Constructor: Initializes a card with the given rank and determines its suit based on the rank
-    Card(int cardRank) : rank(cardRank) {
-        if (rank >= 0 && rank <= 3) {
-            suit = " ♥";
-        } else if (rank >= 4 && rank <= 7) {
-            suit = " ♦";
-        } else if (rank >= 8 && rank <= 11) {
-            suit = " ♣";
-        } else {
-            suit = " ♠";
-        }
+    // Suit symbols and rank names, only used to display cards
+    static const char* const SUIT_GLYPHS[4];
+    static const char* const RANK_NAMES[13];
+
+    // Constructor: Initializes a card from its index in a 52-card deck
+    constexpr Card(int cardIndex = 0) : index(static_cast<unsigned char>(cardIndex)) {}
+
+    // Constructor: Initializes a card from a rank (0-12) and a suit (0-3)
+    constexpr Card(int cardRank, int cardSuit) : index(static_cast<unsigned char>(cardSuit * 13 + cardRank)) {}
+
+    // Getter methods for the card's index, rank (0 = Ace, 12 = King) and suit
+    constexpr int getIndex() const {
+        return index;
     }
 
-    // Copy constructor
-    Card(const Card &other) : rank(other.rank), suit(other.suit) {}
-    
-    // Getter method for retrieving the card's suit
-    string getSuit() const {
-        return suit;
+    constexpr int getRank() const {
+        return index % 13;
+    }
+
+    constexpr int getSuitIndex() const {
+        return index / 13;
+    }
+
+    // Getter method for the card's value with an Ace counted as 1
+    constexpr int getValue() const {
+        return getRank() >= 9 ? 10 : getRank() + 1;
+    }
+
+    // Getter method for retrieving the card's suit symbol
+    const char* getSuit() const {
+        return SUIT_GLYPHS[getSuitIndex()];
+    }
+
+    // Getter method for retrieving the card's rank name (A, 2-10, J, Q, K)
+    const char* getRankName() const {
+        return RANK_NAMES[getRank()];
     }
 
     // Calculates the value of the card in a game, considering the total points and the option to treat an Ace as 11
-    inline int getCardValue(int total, bool aceAsEleven) const {
-        if (rank == 0) {
-            return (total + 11 <= 21 && aceAsEleven) ? 11 : 1;
-        } else if (rank >= 10 && rank <= 12) {
-            return 10;
-        } else {
-            return rank + 1;
-        }
+    constexpr int getCardValue(int total, bool aceAsEleven) const {
+        return (getRank() == 0 && total + 11 <= 21 && aceAsEleven) ? 11 : getValue();
     }
 
     // Overloaded method with a default parameter to simplify calling code
-    inline int getCardValue(int total) const {
+    constexpr int getCardValue(int total) const {
         return getCardValue(total, true);
     }
 
     // Displays a textual representation of the card in a simple ASCII art format
     inline void display() const {
-        string rankString;
-        if (rank == 0) {
-            rankString = "A";
-        } else if (rank >= 10) {
-            rankString = (rank == 10) ? "J" : (rank == 11) ? "Q" : "K";
-        } else {
-            rankString = to_string(rank + 1);
-        }
-
         cout << " _________  \n";
         cout << "|         |  \n";
-        cout << "|" << setw(2) << rankString << "       |  \n";
-        cout << "|   " << setw(2) << suit << "   |  \n";
-        cout << "|      " << setw(2) << rankString << " |  \n";
+        cout << "|" << setw(2) << getRankName() << "       |  \n";
+        cout << "|   " << setw(2) << getSuit() << "   |  \n";
+        cout << "|      " << setw(2) << getRankName() << " |  \n";
         cout << "|_________|  \n";
     }
 
     // Overloaded equality operator to compare two cards
-    bool operator==(const Card& other) const {
-        return rank == other.rank && suit == other.suit;
+    constexpr bool operator==(const Card& other) const {
+        return index == other.index;
+    }
+};
+
+const char* const Card::SUIT_GLYPHS[4] = {" ♥", " ♦", " ♣", " ♠"};
+const char* const Card::RANK_NAMES[13] = {"A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K"};
+
+// Class representing a shoe of one or more shuffled decks that the player and dealer draw from
+class Shoe {
+private:
+    vector<Card> cards;  // Every card in the shoe, in dealing order
+    int position;        // Index of the next card to deal
+    int cutCard;         // Position of the cut card; the shoe is reshuffled once it is reached
+    int deckCount;       // Number of 52-card decks in the shoe
+    double penetration;  // Fraction of the shoe dealt before the cut card
+    RandomEngine& random;  // Each shoe shuffles with its own generator so shoes can be used in parallel
+    ShoeComposition composition;  // Cards not dealt yet, counted by value
+    CardCounter counter;          // Count of the cards dealt since the last shuffle
+
+public:
+    // Constructor: builds and shuffles a shoe of the given number of decks, counted with the given system
+    Shoe(int decks, double cutPenetration, RandomEngine& shoeRandom, const CountingSystem& countingSystem = HI_LO)
+        : position(0), deckCount(max(decks, 1)), penetration(min(max(cutPenetration, 0.1), 1.0)), random(shoeRandom),
+          counter(countingSystem, deckCount) {
+        cards.reserve(deckCount * 52);
+        for (int deck = 0; deck < deckCount; deck++) {
+            for (int index = 0; index < 52; index++) {
+                cards.push_back(Card(index));
+            }
+        }
+        cutCard = static_cast<int>(cards.size() * penetration);
+        shuffle();
+    }
+
+    // Collects every card and shuffles the shoe with a Fisher-Yates shuffle
+    void shuffle() {
+        for (int i = static_cast<int>(cards.size()) - 1; i > 0; i--) {
+            swap(cards[i], cards[random.bounded(i + 1)]);
+        }
+        position = 0;
+        composition = ShoeComposition::fullShoe(deckCount);
+        counter.reset();
+    }
+
+    // Returns true once the cut card has come out; the shoe should be shuffled before the next round
+    bool needsShuffle() const {
+        return position >= cutCard;
+    }
+
+    // Deals the next card face up, so it is counted whoever receives it.
+    // A shoe that runs out mid-round is reshuffled.
+    Card draw() {
+        if (position == static_cast<int>(cards.size())) {
+            shuffle();
+        }
+        int rank = cards[position].getRank();
+        composition.remove(valueIndex(rank));
+        counter.see(rank);
+        return cards[position++];
+    }
+
+    // Returns the card the next draw will deal without dealing it. A shoe that has run out is
+    // reshuffled first, as draw() would do.
+    Card peek() {
+        if (position == static_cast<int>(cards.size())) {
+            shuffle();
+        }
+        return cards[position];
+    }
+
+    // Getter function for the cards not dealt yet, counted by value
+    const ShoeComposition& getComposition() const {
+        return composition;
+    }
+
+    // Getter function for the number of cards left before the end of the shoe
+    int getRemaining() const {
+        return static_cast<int>(cards.size()) - position;
+    }
+
+    // Getter function for the count of the cards dealt since the last shuffle
+    const CardCounter& getCounter() const {
+        return counter;
+    }
+
+    // Running count per deck left in the shoe
+    double getTrueCount() const {
+        return counter.trueCount(getRemaining());
+    }
+
+    // Getter function for the number of decks in the shoe
+    int getDeckCount() const {
+        return deckCount;
+    }
+};
+
+// Class representing a hand of cards, stored inline with a fixed capacity so dealing never allocates
+class Hand {
+public:
+    // Every card adds at least 1 to the hard total and nobody draws once it reaches 21,
+    // so no hand can hold more than 21 cards, however many decks are in the shoe
+    static const int MAX_CARDS = 21;
+
+private:
+    Card cards[MAX_CARDS];  // Cards in the order they were dealt
+    int count;              // Number of cards in the hand
+    int hardTotal;          // Total with every Ace counted as 1
+    int aceCount;           // Number of Aces in the hand; one of them can count as 11
+
+public:
+    // Constructor: starts with an empty hand
+    Hand() : count(0), hardTotal(0), aceCount(0) {}
+
+    // Removes every card from the hand
+    void clear() {
+        count = 0;
+        hardTotal = 0;
+        aceCount = 0;
+    }
+
+    // Adds a card to the hand and updates the running totals
+    void add(Card card) {
+        if (count < MAX_CARDS) {
+            cards[count++] = card;
+            hardTotal += card.getValue();
+            aceCount += card.getRank() == 0;
+            assert(total() == recomputeTotal());
+        }
+    }
+
+    // Returns true if an Ace is counted as 11
+    bool isSoft() const {
+        return aceCount > 0 && hardTotal + 10 <= 21;
+    }
+
+    // Best total of the hand, counting one Ace as 11 when that does not bust
+    int total() const {
+        return isSoft() ? hardTotal + 10 : hardTotal;
+    }
+
+    // Returns true if the hand is over 21
+    bool isBust() const {
+        return hardTotal > 21;
+    }
+
+#ifndef NDEBUG
+    // Recalculates the total from scratch, considering aces. Only used to cross-check total() in debug builds.
+    int recomputeTotal() const {
+        int total = 0;
+        int softAces = 0;
+
+        for (const auto &card : *this) {
+            int cardValue = card.getCardValue(total, true);
+            total += cardValue;
+
+            if (cardValue == 11) {
+                softAces++;
+            }
+
+            // Handle aces as 1 if needed to avoid busting
+            while (total > 21 && softAces > 0) {
+                total -= 10;
+                softAces--;
+            }
+        }
+        return total;
+    }
+#endif
+
+    // Getter functions for the number of cards and the most recent card
+    int size() const {
+        return count;
+    }
+
+    Card back() const {
+        return cards[count - 1];
+    }
+
+    // Iterators so a hand can be used in range-based for loops
+    const Card* begin() const {
+        return cards;
+    }
+
+    const Card* end() const {
+        return cards + count;
     }
 };
 
 // Class representing a player in a card game
 class Player {
 private:
-    vector<Card> cards;            // Player's current hand of cards
+    Hand cards;                     // Player's current hand of cards
     float balance;                  // Player's balance or money
     bool doubleDown;                // Flag indicating whether the player has chosen to double down
     float xpMultiplier;             // Experience multiplier for the player
@@ -105,9 +345,6 @@ public:
     // Destructor
     ~Player() {}
 
-    // Friend function to add a card to the dealer's hand during a Blackjack game.
-    friend int addCardToDealer(Player& player, vector<Card>& dealerCards, int& dealerTotal);
-    
     // Getter function for experience multiplier
     float getXPMultiplier() const {
         return xpMultiplier;
@@ -128,59 +365,26 @@ public:
         betMultiplier = multiplier;
     }
     
-    // Initializes the player's hand with a specified number of cards
-    void initialize(int cardCount) {
+    // Initializes the player's hand for a new round
+    void initialize() {
         cards.clear();
-        cards.reserve(cardCount);
     }
 
-    // Array of suit names for card display
-    const string suitNames[5] = {" ♥", " ♦", " ♣", " ♠"};
-
-    // Deals a specified number of initial cards to the player
-    void dealInitialCards(int cardCount) {
-        set<pair<int, string>> usedCards;
-
+    // Deals a specified number of initial cards to the player from the shoe
+    void dealInitialCards(int cardCount, Shoe& shoe) {
         for (int i = 0; i < cardCount; i++) {
-            int newRank;
-            string newSuit;
-
-            // Generate a random card that has not been used before
-            do {
-                newRank = rand() % 13;
-                newSuit = (newRank / 4 == 0) ? " ♥" : (newRank / 4 == 1) ? " ♦" : (newRank / 4 == 2) ? " ♣" : " ♠";
-            } while (usedCards.count({newRank, newSuit}) > 0);
-
-            cards.push_back(Card(newRank));
-            usedCards.insert({newRank, newSuit});
+            cards.add(shoe.draw());
         }
     }
 
     // Getter function for the player's current hand
-    const vector<Card>& getCards() const {
+    const Hand& getCards() const {
         return cards;
     }
     
-    // Calculates the total value of the player's hand considering aces
+    // Getter function for the total value of the player's hand considering aces
     int getTotal() const {
-        int total = 0;
-        int aceCount = 0;
-
-        for (const auto &card : cards) {
-            int cardValue = card.getCardValue(total, true);
-            total += cardValue;
-
-            if (cardValue == 11) {
-                aceCount++;
-            }
-
-            // Handle aces as 1 if needed to avoid busting
-            while (total > 21 && aceCount > 0) {
-                total -= 10;
-                aceCount--;
-            }
-        }
-        return total;
+        return cards.total();
     }
 
     // Getter function for the player's balance
@@ -203,18 +407,9 @@ public:
         doubleDown = value;
     }
     
-    // Adds a new card to the player's hand, ensuring it has not been used before
-    int addCard() {
-        int newRank;
-        string newSuit;
-
-        // Generate a random card that has not been used before
-        do {
-            newRank = rand() % 13;
-            newSuit = (newRank / 4 == 0) ? " ♥" : (newRank / 4 == 1) ? " ♦" : (newRank / 4 == 2) ? " ♣" : " ♠";
-        } while (find(cards.begin(), cards.end(), Card(newRank)) != cards.end());
-
-        cards.push_back(Card(newRank));
+    // Adds the next card from the shoe to the player's hand
+    int addCard(Shoe& shoe) {
+        cards.add(shoe.draw());
 
         // Return the updated total value of the player's hand
         return getTotal();
@@ -229,8 +424,8 @@ private:
     float xpMultiplier;      // Multiplier affecting experience point gain
 
 public:
-    // Default constructor initializes the level to 1 and experiencePoints to 0
-    ExperienceLevel() : level(1), experiencePoints(0) {}
+    // Default constructor initializes the level to 1, experiencePoints to 0 and the multiplier to 1x
+    ExperienceLevel() : level(1), experiencePoints(0), xpMultiplier(1.0) {}
 
     // Getter method to retrieve the experience point multiplier
     float getXPMultiplier() const {
@@ -247,14 +442,27 @@ public:
         return experiencePoints;
     }
 
+    // Setter method for the current level, used when a saved profile is loaded
+    void setLevel(int newLevel) {
+        level = newLevel;
+    }
+
+    // Setter method for the experience points, used when a saved profile is loaded
+    void setExperiencePoints(int points) {
+        experiencePoints = points;
+    }
+
     // Method to simulate gaining experience points and handle level-ups
-    void gainExperience(int points) {
+    // Pass announce = false to level up silently (used by the simulator)
+    void gainExperience(int points, bool announce = true) {
         experiencePoints += points;
         
         if (experiencePoints >= level * 100) {
             experiencePoints -= level * 100;
             level++;
-            cout << "   - Level up! New Level: " << level << "! -\n";
+            if (announce) {
+                cout << "   - Level up! New Level: " << level << "! -\n";
+            }
         }
     }
 
@@ -265,36 +473,7 @@ public:
         return levelBettingLimits[adjustedLevel - 1];
     }
     
-    // Method to reset the experience level and save it to a binary file
-    void resetXPFile(ExperienceLevel& experienceLevel, const string& filename, int defaultLevel = 1, int defaultXP = 0) {
-        ofstream file(filename, ios::binary | ios::out);
-        if (file.is_open()) {
-            experienceLevel = ExperienceLevel();
-            experienceLevel.gainExperience(defaultXP); 
-            int level = experienceLevel.getLevel();
-            int xp = experienceLevel.getExperiencePoints();
-            file.write(reinterpret_cast<const char*>(&level), sizeof(level));
-            file.write(reinterpret_cast<const char*>(&xp), sizeof(xp));
-            file.close();
-            cout << " XP file reset to: Level: " << defaultLevel << endl;
-        } else {
-        cout << " Unable to open file for resetting XP." << endl;
-    }
-}
-    
-    // Method to save the current experience level to a binary file
-    void saveExperience(const string& filename) const {
-        ofstream file(filename, ios::binary | ios::out);
-        if (file.is_open()) {
-            file.write(reinterpret_cast<const char*>(&level), sizeof(level));
-            file.write(reinterpret_cast<const char*>(&experiencePoints), sizeof(experiencePoints));
-            file.close();
-        } else {
-            cout << " Unable to open file for saving experience level." << endl;
-        }
-    }
-
-    // Method to load the experience level from a binary file
+    // Method to load the experience level from a binary file (the format before profile.bin)
     void loadExperience(const string& filename) {
         ifstream file(filename, ios::binary | ios::in);
         if (file.is_open()) {
@@ -450,139 +629,464 @@ bool promptForPurchase(Player& player, Shop& shop, int option) {
     }
 }
 
-// Function to add a card to the dealer's hand
-int addCardToDealer(Player& player, vector<Card>& dealerCards, int& dealerTotal) {
-    // Variables to store the new card's rank and suit
-    int newRank;
-    string newSuit;
-
-    // Generate a random rank for the new card and determine its suit based on the rank
-    do {
-        newRank = rand() % 13;
-        newSuit = (newRank / 4 == 0) ? " ♥" : (newRank / 4 == 1) ? " ♦" : (newRank / 4 == 2) ? " ♣" : " ♠";
-    } while (find(dealerCards.begin(), dealerCards.end(), Card(newRank)) != dealerCards.end());
-
-    // Add the new card to the dealer's hand
-    dealerCards.push_back(Card(newRank));
-
-    // Calculate the new total value of the dealer's hand, adjusting for Ace value if necessary
-    int total = dealerTotal + dealerCards.back().getCardValue(dealerTotal);
-    if (total > 21) {
-        // Check for Aces and adjust total if necessary
-        for (const auto& card : dealerCards) {
-            if (card.getCardValue(dealerTotal) == 11) {
-                total -= 10;
-            }
+// States a round moves through inside the GameEngine
+enum class GameState {
+    AwaitBet,         // Waiting for the player's bet
+    AwaitDoubleDown,  // Waiting for the double down decision
+    AwaitHitStand,    // Waiting for the player to hit or stand
+    DealerTurn,       // The dealer has to play out their hand
+    Settled           // The round is over and the bet has been paid or collected
+};
+
+// Kinds of actions a driver can send to the GameEngine
+enum class ActionType {
+    Bet,           // Place a bet of the given amount
+    DoubleDown,    // Double the bet and draw exactly one more card
+    NoDoubleDown,  // Keep the original bet
+    Hit,           // Draw another card
+    Stand          // Keep the current hand
+};
+
+// An action sent to the GameEngine as a plain value
+struct Action {
+    ActionType type;
+    float amount;  // Bet amount, only used by ActionType::Bet
+
+    Action(ActionType actionType, float betAmount = 0) : type(actionType), amount(betAmount) {}
+};
+
+// How a round ended
+enum class RoundOutcome {
+    DoubleDownBlackjack,  // 21 on the double down card
+    DoubleDownBust,       // Over 21 on the double down card
+    FirstTryBlackjack,    // 21 with the first two cards
+    Blackjack,            // 21 after hitting
+    Bust,                 // Over 21 after hitting
+    DealerBust,           // The dealer went over 21
+    DealerWins,           // The dealer's total is higher
+    Tie,                  // Both totals are equal
+    PlayerWins            // The player's total is higher
+};
+
+// Result of a settled round, kept so drivers can report it however they like
+struct Settlement {
+    RoundOutcome outcome;
+    bool doubledDown;      // Whether the player doubled down
+    float amount;          // Money shown to the player as won or lost
+    float balanceChange;   // Net change of the balance over the whole round
+    int xp;                // Base XP of the outcome, before the multiplier
+    int xpAwarded;         // XP actually passed to ExperienceLevel::gainExperience
+    bool levelUp;          // Whether the award caused a level up
+    float balance;         // Player's balance after settlement
+    int level;             // Player's level after settlement
+    int experiencePoints;  // Player's experience points after settlement
+};
+
+// Runs the rules of one blackjack round as a state machine, without any console I/O.
+// Drivers (the console, the simulator, ...) send actions with apply() and read the state back.
+class GameEngine {
+private:
+    Player& player;
+    ExperienceLevel& experienceLevel;
+    GameState state;
+    float bet;
+    float balanceChange;
+    bool doubledDown;
+    Hand dealerCards;
+    int dealerTotal;
+    Card upcard;  // Dealer's first card, or the card they would have been dealt first
+    Settlement settlement;
+    Shoe& shoe;
+
+    // Pays out or collects the bet, awards XP and ends the round
+    void settle(RoundOutcome outcome, float amount, int xp, int xpAwarded) {
+        int levelBefore = experienceLevel.getLevel();
+        upcard = dealerCards.size() > 0 ? *dealerCards.begin() : shoe.peek();
+
+        player.setBalance(player.getBalance() + amount);
+        balanceChange += amount;
+        experienceLevel.gainExperience(xpAwarded, false);
+
+        settlement.outcome = outcome;
+        settlement.doubledDown = doubledDown;
+        settlement.amount = amount < 0 ? -amount : amount;
+        settlement.balanceChange = balanceChange;
+        settlement.xp = xp;
+        settlement.xpAwarded = xpAwarded;
+        settlement.levelUp = experienceLevel.getLevel() != levelBefore;
+        settlement.balance = player.getBalance();
+        settlement.level = experienceLevel.getLevel();
+        settlement.experiencePoints = experienceLevel.getExperiencePoints();
+        state = GameState::Settled;
+    }
+
+    // Pays 3x the bet for any 21
+    void settleBlackjack(RoundOutcome outcome, int xp) {
+        settle(outcome, bet * 3 * player.getBetMultiplier(), xp, xp * experienceLevel.getXPMultiplier());
+    }
+
+public:
+    // Constructor: the engine plays rounds for the given player and experience level,
+    // dealing the player and the dealer from the given shoe
+    GameEngine(Player& enginePlayer, ExperienceLevel& engineExperienceLevel, Shoe& engineShoe)
+        : player(enginePlayer), experienceLevel(engineExperienceLevel), state(GameState::Settled),
+          bet(0), balanceChange(0), doubledDown(false), dealerTotal(0), shoe(engineShoe) {}
+
+    // Deals the player's initial cards and waits for a bet. The shoe is shuffled first once the cut card is out.
+    void startRound() {
+        if (shoe.needsShuffle()) {
+            shoe.shuffle();
         }
+        player.initialize();
+        player.dealInitialCards(2, shoe);
+        dealerCards.clear();
+        dealerTotal = 0;
+        bet = 0;
+        balanceChange = 0;
+        doubledDown = false;
+        state = GameState::AwaitBet;
     }
 
-    // Update the dealer's total value
-    dealerTotal = total;
-    
-    // Return the value of the last added card
-    return dealerCards.back().getCardValue(dealerTotal);
-}
+    // Applies an action; returns false if it is not allowed in the current state
+    bool apply(const Action& action) {
+        switch (state) {
+            case GameState::AwaitBet:
+                if (action.type != ActionType::Bet || action.amount < 5 || action.amount > experienceLevel.getBettingLimit()) {
+                    return false;
+                }
+                bet = action.amount;
+                state = GameState::AwaitDoubleDown;
+                return true;
 
-// Function to display the cards in a visually appealing format
-void displayCards(const vector<Card>& cards) {
-    // Loop through each card and print its representation in a row
-    for (const auto& card : cards) {
-        string rankString;
-        // Determine the string representation of the card's rank
-        if (card.getCardValue(0) == 1) {
-            rankString = "A";
-        } else if (card.getCardValue(0) >= 10) {
-            rankString = (card.getCardValue(0) == 10) ? "10" : (card.getCardValue(0) == 11) ? "J" : (card.getCardValue(0) == 12) ? "Q" : "K";
+            case GameState::AwaitDoubleDown:
+                if (action.type == ActionType::DoubleDown) {
+                    // Pay the extra stake up front and draw exactly one more card
+                    float originalBet = bet;
+                    bet *= 2;
+                    player.setBalance(player.getBalance() - originalBet);
+                    balanceChange -= originalBet;
+                    doubledDown = true;
+                    player.setDoubleDown(true);
+                    player.addCard(shoe);
+
+                    if (player.getTotal() == 21) {
+                        settleBlackjack(RoundOutcome::DoubleDownBlackjack, 40);
+                    } else if (player.getTotal() > 21) {
+                        settle(RoundOutcome::DoubleDownBust, -bet, -10, -10);
+                    } else {
+                        state = GameState::DealerTurn;
+                    }
+                    return true;
+                }
+                if (action.type == ActionType::NoDoubleDown) {
+                    if (player.getTotal() == 21) {
+                        settleBlackjack(RoundOutcome::FirstTryBlackjack, 20);
+                    } else {
+                        state = GameState::AwaitHitStand;
+                    }
+                    return true;
+                }
+                return false;
+
+            case GameState::AwaitHitStand:
+                if (action.type == ActionType::Hit) {
+                    player.addCard(shoe);
+                    if (player.getTotal() == 21) {
+                        settleBlackjack(RoundOutcome::Blackjack, 20);
+                    } else if (player.getTotal() > 21) {
+                        settle(RoundOutcome::Bust, -bet, -5, -5);
+                    }
+                    return true;
+                }
+                if (action.type == ActionType::Stand) {
+                    state = GameState::DealerTurn;
+                    return true;
+                }
+                return false;
+
+            default:
+                return false;
+        }
+    }
+
+    // Dealer draws cards until their total is at least 17, then the bet is settled.
+    // Each draw is a single lookup in the dealer's transition table.
+    void playDealer() {
+        if (state != GameState::DealerTurn) {
+            return;
+        }
+
+        DealerTransition dealer = DealerTable::start();
+        while (!dealer.stand) {
+            Card card = shoe.draw();
+            dealerCards.add(card);
+            dealer = DEALER_TABLE.next(dealer.hardTotal, dealer.soft, card.getRank());
+        }
+        dealerTotal = dealer.total();
+
+        float betMultiplier = player.getBetMultiplier();
+        float xpMultiplier = experienceLevel.getXPMultiplier();
+        if (dealerTotal > 21) {
+            settle(RoundOutcome::DealerBust, bet * 2 * betMultiplier, 10, 10 * xpMultiplier);
+        } else if (dealerTotal > player.getTotal()) {
+            settle(RoundOutcome::DealerWins, -bet, -5, -5);
+        } else if (dealerTotal == player.getTotal()) {
+            settle(RoundOutcome::Tie, 0, 5, 5 * xpMultiplier);
         } else {
-            rankString = to_string(card.getCardValue(0));
+            settle(RoundOutcome::PlayerWins, bet * 2 * betMultiplier, 10, 10 * xpMultiplier);
         }
+    }
+
+    // Getter functions for drivers
+    GameState getState() const {
+        return state;
+    }
+
+    float getBet() const {
+        return bet;
+    }
+
+    Player& getPlayer() const {
+        return player;
+    }
+
+    ExperienceLevel& getExperienceLevel() const {
+        return experienceLevel;
+    }
+
+    // The dealer's first card; in a round settled before the dealer played (a bust or a 21), the
+    // card the dealer would have been dealt first, which is the next card in the shoe
+    Card getUpcard() const {
+        return upcard;
+    }
+
+    const Hand& getDealerCards() const {
+        return dealerCards;
+    }
+
+    int getDealerTotal() const {
+        return dealerTotal;
+    }
+
+    const Settlement& getSettlement() const {
+        return settlement;
+    }
 
+    Shoe& getShoe() const {
+        return shoe;
+    }
+};
+
+// Function to display the cards in a visually appealing format
+void displayCards(const Hand& cards) {
+    // Loop through each card and print its representation in a row
+    for (int i = 0; i < cards.size(); i++) {
         cout << " _________  ";
     }
     cout << endl;
 
-    for (const auto& card : cards) {
-        string rankString;
-        if (card.getCardValue(0) == 1) {
-            rankString = "A";
-        } else if (card.getCardValue(0) >= 10) {
-            rankString = (card.getCardValue(0) == 10) ? "10" : (card.getCardValue(0) == 11) ? "J" : (card.getCardValue(0) == 12) ? "Q" : "K";
-        } else {
-            rankString = to_string(card.getCardValue(0));
-        }
-
+    for (int i = 0; i < cards.size(); i++) {
         cout << "|         | ";
     }
     cout << endl;
 
     for (const auto& card : cards) {
-        string rankString;
-        if (card.getCardValue(0) == 1) {
-            rankString = "A";
-        } else if (card.getCardValue(0) >= 10) {
-            rankString = (card.getCardValue(0) == 10) ? "10" : (card.getCardValue(0) == 11) ? "J" : (card.getCardValue(0) == 12) ? "Q" : "K";
-        } else {
-            rankString = to_string(card.getCardValue(0));
-        }
-
-        cout << "|" << setw(2) << rankString << "       | ";
+        cout << "|" << setw(2) << card.getRankName() << "       | ";
     }
     cout << endl;
 
     for (const auto& card : cards) {
-        string rankString;
-        if (card.getCardValue(0) == 1) {
-            rankString = "A";
-        } else if (card.getCardValue(0) >= 10) {
-            rankString = (card.getCardValue(0) == 10) ? "10" : (card.getCardValue(0) == 11) ? "J" : (card.getCardValue(0) == 12) ? "Q" : "K";
-        } else {
-            rankString = to_string(card.getCardValue(0));
-        }
-
         cout << "|   " << setw(2) << card.getSuit() << "   | ";
     }
     cout << endl;
 
     for (const auto& card : cards) {
-        string rankString;
-        if (card.getCardValue(0) == 1) {
-            rankString = "A";
-        } else if (card.getCardValue(0) >= 10) {
-            rankString = (card.getCardValue(0) == 10) ? "10" : (card.getCardValue(0) == 11) ? "J" : (card.getCardValue(0) == 12) ? "Q" : "K";
-        } else {
-            rankString = to_string(card.getCardValue(0));
-        }
+        cout << "|      " << setw(2) << card.getRankName() << " | ";
+    }
+    cout << endl;
 
-        cout << "|      " << setw(2) << rankString << " | ";
+    for (int i = 0; i < cards.size(); i++) {
+        cout << "|_________| ";
     }
     cout << endl;
+}
 
-    for (const auto& card : cards) {
-        string rankString;
-        if (card.getCardValue(0) == 1) {
-            rankString = "A";
-        } else if (card.getCardValue(0) >= 10) {
-            rankString = (card.getCardValue(0) == 10) ? "10" : (card.getCardValue(0) == 11) ? "J" : (card.getCardValue(0) == 12) ? "Q" : "K";
-        } else {
-            rankString = to_string(card.getCardValue(0));
+// Function to print the precomputed strategy table's advice for the player's hand, followed by the
+// expected value of each action from the background hint worker
+void displayHint(const Player& player, bool canDoubleDown, HintWorker& hints) {
+    int total = player.getTotal();
+    bool soft = player.getCards().isSoft();
+    float betMultiplier = player.getBetMultiplier();
+
+    cout << "Hint: ";
+    if (canDoubleDown && STRATEGY_TABLE.doubleDown(total, soft, betMultiplier)) {
+        cout << "double down.\n";
+    } else if (canDoubleDown) {
+        cout << "don't double down, then " << (STRATEGY_TABLE.hit(total, soft, betMultiplier) ? "hit" : "stay") << ".\n";
+    } else {
+        cout << (STRATEGY_TABLE.hit(total, soft, betMultiplier) ? "hit" : "stay") << ".\n";
+    }
+
+    ActionValues values;
+    if (hints.values(values)) {
+        cout << showpos << fixed << setprecision(2);
+        cout << "Expected return per $1 bet: stay " << values.stand << ", hit " << values.hit;
+        if (canDoubleDown) {
+            cout << ", double down " << values.doubleDown;
         }
+        cout << noshowpos << "\nChance a hit busts: " << setprecision(0) << values.bustChance * 100 << "%\n";
+        cout << setprecision(2);
+    }
+}
 
-        cout << "|_________| ";
+// Function to print the result of a settled round
+void displaySettlement(const Settlement& settlement) {
+    bool won = false;
+    cout << fixed << setprecision(2);
+    cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    switch (settlement.outcome) {
+        case RoundOutcome::DoubleDownBlackjack:
+        case RoundOutcome::Blackjack:
+            cout << "       Blackjack! You win!\n\n";
+            won = true;
+            break;
+        case RoundOutcome::FirstTryBlackjack:
+            cout << " Lucky you, first try Blackjack!\n";
+            cout << "           You win!\n\n";
+            won = true;
+            break;
+        case RoundOutcome::DoubleDownBust:
+        case RoundOutcome::Bust:
+            cout << "        Bust! You lose.\n\n";
+            break;
+        case RoundOutcome::DealerBust:
+            cout << "       The dealer busts!\n";
+            cout << "   Congratulations, you win!\n\n";
+            won = true;
+            break;
+        case RoundOutcome::DealerWins:
+            cout << "        The dealer wins.\n\n";
+            break;
+        case RoundOutcome::Tie:
+            cout << "          It's a tie!\n";
+            break;
+        case RoundOutcome::PlayerWins:
+            cout << "   Congratulations, you win!\n\n";
+            won = true;
+            break;
     }
-    cout << endl;
+
+    // Winnings or losses, then the new balance and XP
+    if (won) {
+        cout << "        You made $" << settlement.amount << "!\n";
+    } else if (settlement.outcome != RoundOutcome::Tie) {
+        cout << "        You lost $" << settlement.amount << "\n";
+    }
+    cout << "  - Your balance is: $" << settlement.balance << " -\n";
+    if (settlement.levelUp) {
+        cout << "   - Level up! New Level: " << settlement.level << "! -\n";
+    }
+    if (settlement.xp > 0) {
+        cout << "       - XP +" << settlement.xp << " (" << settlement.experiencePoints << "/100) -\n";
+    } else {
+        cout << "        - XP: " << settlement.xp << " (" << settlement.experiencePoints << "/100) -\n";
+    }
+    cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
 }
 
-// Function to add a card to the dealer's hand and update the dealer's total
-int addCardToDealer(Player& player, vector<Card>& dealerCards, int& dealerTotal);
+ProfileRecord makeProfile(const Player& player, const ExperienceLevel& experienceLevel, uint32_t journalSequence);
+// Records everything that changes the player's profile. Each change is appended to the journal
+// straight away, and every few entries a snapshot of the profile is handed to the write-behind
+// thread so the journal tail replayed on startup stays short. If an append fails, a snapshot is
+// taken right away instead, so the change is still saved.
+class ProfileRecorder {
+private:
+    RoundJournal& journal;
+    ProfileWriter& writer;
+    const Player& player;
+    const ExperienceLevel& experienceLevel;
+    uint32_t snapshotInterval;  // Journal entries between two snapshots
+    uint32_t snapshotSequence;  // Last journal entry covered by a snapshot
+
+    // Appends an entry with the player's balance and multipliers after the change
+    void record(JournalEntry entry) {
+        entry.balance = player.getBalance();
+        entry.xpMultiplier = player.getXPMultiplier();
+        entry.betMultiplier = player.getBetMultiplier();
+        if (!journal.append(entry) || journal.getSequence() - snapshotSequence >= snapshotInterval) {
+            snapshot();
+        }
+    }
 
-// Function to execute a single round of the blackjack game
-// Takes player information, experience level, and shop as parameters
-bool playRound(Player& player, ExperienceLevel& experienceLevel, Shop& shop) {
-    // Flag to check if a blackjack has occurred during the round
-    bool bj = false;
+public:
+    // Constructor: the journal and the snapshot saved when the profile was loaded start in step
+    ProfileRecorder(RoundJournal& roundJournal, ProfileWriter& profileWriter, const Player& recordedPlayer,
+                    const ExperienceLevel& recordedExperienceLevel, int interval)
+        : journal(roundJournal), writer(profileWriter), player(recordedPlayer),
+          experienceLevel(recordedExperienceLevel), snapshotInterval(max(interval, 1)),
+          snapshotSequence(roundJournal.getSequence()) {}
+
+    // Journals a settled round: the bet, both hands, the player's decisions, the payout and the XP
+    void recordRound(const GameEngine& engine) {
+        const Settlement& settlement = engine.getSettlement();
+        JournalEntry entry;
+        entry.kind = JOURNAL_ROUND;
+        entry.bet = engine.getBet();
+        entry.balanceChange = settlement.balanceChange;
+        entry.xpAwarded = settlement.xpAwarded;
+        entry.outcome = static_cast<uint8_t>(settlement.outcome);
+        entry.actions = settlement.doubledDown ? JOURNAL_DOUBLED_DOWN
+                      : engine.getDealerCards().size() > 0 ? JOURNAL_STOOD : 0;
+
+        // Cards beyond what an entry holds are counted but not stored; only absurd runs of small
+        // cards get there
+        int stored = 0;
+        for (const Card& card : player.getCards()) {
+            if (stored < JOURNAL_CARDS) {
+                entry.cards[stored++] = static_cast<uint8_t>(card.getIndex());
+            }
+        }
+        for (const Card& card : engine.getDealerCards()) {
+            if (stored < JOURNAL_CARDS) {
+                entry.cards[stored++] = static_cast<uint8_t>(card.getIndex());
+            }
+        }
+        entry.playerCardCount = static_cast<uint8_t>(player.getCards().size());
+        entry.dealerCardCount = static_cast<uint8_t>(engine.getDealerCards().size());
+        record(entry);
+    }
+
+    // Journals a change to the balance and multipliers made outside a round: a shop purchase,
+    // or a reset to a new player's profile
+    void recordChange(JournalKind kind, float balanceChange) {
+        JournalEntry entry;
+        entry.kind = kind;
+        entry.balanceChange = balanceChange;
+        record(entry);
+    }
+
+    // Hands a snapshot of the profile, covering every journal entry so far, to the writer thread
+    void snapshot() {
+        writer.submit(makeProfile(player, experienceLevel, journal.getSequence()));
+        snapshotSequence = journal.getSequence();
+    }
+};
+
+// Function to offer the shop and journal whatever the player bought
+bool visitShop(Player& player, Shop& shop, ProfileRecorder& recorder) {
+    float balanceBeforeShop = player.getBalance();
+    bool visited = promptForShop(player, shop);
+    if (player.getBalance() != balanceBeforeShop) {
+        recorder.recordChange(JOURNAL_PURCHASE, player.getBalance() - balanceBeforeShop);
+    }
+    return visited;
+}
 
-    // Initial number of cards dealt to the player
-    int pcards = 2;
+// Function to execute a single round of the blackjack game
+// Drives the game engine from the console and offers the shop afterwards
+bool playRound(GameEngine& engine, Shop& shop, HintWorker& hints, ProfileRecorder& recorder) {
+    Player& player = engine.getPlayer();
+    ExperienceLevel& experienceLevel = engine.getExperienceLevel();
 
     // Display player information and betting options
     cout << "---------------------------------\n";
@@ -599,7 +1103,7 @@ bool playRound(Player& player, ExperienceLevel& experienceLevel, Shop& shop) {
     cout << "---------------------------------\n";
 
     // Validate the bet amount to be within the allowed range
-    while (bet < 5 || bet > experienceLevel.getBettingLimit()) {
+    while (!engine.apply(Action(ActionType::Bet, bet))) {
         cout << "Please choose an amount between $5.00 and $" << fixed << setprecision(2) << experienceLevel.getBettingLimit() << "\n";
         cout << "Your bet: $";
         cin >> bet;
@@ -615,247 +1119,88 @@ bool playRound(Player& player, ExperienceLevel& experienceLevel, Shop& shop) {
     // Variable to store the player's choice for doubling down
     char doubleDownChoice;
 
-    // Flag to determine if the player can hit or stand
-    bool canHitOrStand = true;
-
-    // Flag to track if it is the first attempt to achieve blackjack
-    bool firstTryBlackjack = false;
-    
 // This loop prompts the player for a decision on whether to double down in the game
-while (true) {
+while (engine.getState() == GameState::AwaitDoubleDown) {
+    // Solve the hints in the background while waiting for the answer
+    hints.start(engine.getShoe().getComposition(), player.getTotal(), player.getCards().isSoft(), player.getBetMultiplier());
     cout << "---------------------------------\n";
     cout << "Do you want to double down?\nEnter 'Y' to continue or 'N' to exit.\n";
+    cout << "Enter '?' for a hint.\n";
     cin >> doubleDownChoice;
+    if (doubleDownChoice != '?') {
+        hints.cancel();
+    }
 
-    // If the player chooses to double down
+    // If the player chooses to double down, show the extra card
     if (doubleDownChoice == 'Y' || doubleDownChoice == 'y') {
         cout << "---------------------------------\n";
-        
-        // Store the original bet, double the current bet, and update player balance.
-        float originalBet = bet;
-        bet *= 2;
-        player.setBalance(player.getBalance() - originalBet);
-        player.setDoubleDown(true);
-        
-        // Draw an additional card for the player after doubling down.
-        player.addCard();
+        engine.apply(Action(ActionType::DoubleDown));
         cout << "Your cards after doubling down:\n";
         displayCards(player.getCards());
-        int doubledDownTotal = player.getTotal();
         cout << "\nTotal: " << player.getTotal() << endl;
-
-        // Check for a blackjack after doubling down
-        if (doubledDownTotal == 21) {
-           float betMultiplier = player.getBetMultiplier();
-           float xpMultiplier = experienceLevel.getXPMultiplier();
-           // Calculate winnings, update player balance, and award experience points
-           float betadd = (bet * 3) * betMultiplier;
-           cout << fixed << setprecision(2);
-           cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-           cout << "       Blackjack! You win!\n\n";
-           cout << "        You made $" << betadd << "!\n";
-           player.setBalance((bet * 3 * betMultiplier) + player.getBalance());
-           cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-           experienceLevel.gainExperience(40 * xpMultiplier);
-           cout << "       - XP +40" << " (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-           cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-           bj = true;
-           
-           if (!player.getDoubleDown()) {
-                    firstTryBlackjack = true;
-                }
-        // Display a message indicating a bust, deduct the bet, and update experience points
-        } else if (doubledDownTotal > 21) {
-            cout << fixed << setprecision(2);
-            cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-            cout << "        Bust! You lose.\n\n";
-            cout << "        You lost $" << bet << "\n";
-            player.setBalance(player.getBalance() - bet);
-            cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-            experienceLevel.gainExperience(-10);
-            cout << "        - XP: -10 (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-            cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-            bj = true;
-
-        // If no immediate win or loss, disable further hits or stands
-        } else {
-            canHitOrStand = false;
-        }
-
-        break;
-    // If the player chooses not to double down, enable further hits or stands and exit the loop
     } else if (doubleDownChoice == 'N' || doubleDownChoice == 'n') {
-        canHitOrStand = true;
-        break;
+        engine.apply(Action(ActionType::NoDoubleDown));
+    } else if (doubleDownChoice == '?') {
+        displayHint(player, true, hints);
     } else {
         cout << "Invalid choice. Please enter 'Y' or 'N'.\n";
     }
 }
-    
-// Check if the player has a Blackjack on the first try
-if (player.getTotal() == 21 && !firstTryBlackjack) {
-    // Retrieve bet and experience multipliers
-    float betMultiplier = player.getBetMultiplier();
-    float xpMultiplier = experienceLevel.getXPMultiplier();
-
-    // Calculate the winnings and update player's balance
-    float betadd = (bet * 3) * betMultiplier;
-    player.setBalance((bet * 3 * betMultiplier) + player.getBalance());
-
-    // Display the result and update experience points
-    cout << fixed << setprecision(2);
-    cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-    cout << " Lucky you, first try Blackjack!\n";
-    cout << "           You win!\n\n";
-    cout << "        You made $" << betadd << "!\n";
-    cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-    experienceLevel.gainExperience(20 * xpMultiplier);
-    cout << "       - XP +20" << " (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-    cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-
-    // Set the flag to indicate that the player achieved Blackjack on the first try
-    bj = true;
-}
 
 // Player's turn to decide whether to hit or stand
 char choice;
-bool turn = true;
 
 // This loop manages the player's turn in the blackjack game
-while (player.getTotal() < 21 && turn && canHitOrStand == true) {
+while (engine.getState() == GameState::AwaitHitStand) {
+    hints.start(engine.getShoe().getComposition(), player.getTotal(), player.getCards().isSoft(), player.getBetMultiplier());
     cout << "---------------------------------\n";
-    cout << "Enter 'H' to hit or 'S' to stay.\n";
+    cout << "Enter 'H' to hit or 'S' to stay ('?' for a hint).\n";
     cin >> choice;
     cin.ignore();
+    if (choice != '?') {
+        hints.cancel();
+    }
     cout << "---------------------------------\n";
 
     // If the player chooses to hit
     if (choice == 'H' or choice == 'h') {
-        pcards++;
-        player.addCard();
+        engine.apply(Action(ActionType::Hit));
         cout << "Your cards:\n";
         displayCards(player.getCards());
         cout << "\nTotal: " << player.getTotal() << endl;
-
-        // Calculate multipliers for bet and experience points
-        float betMultiplier = player.getBetMultiplier();
-        float xpMultiplier = experienceLevel.getXPMultiplier();
-
-        // If the player gets a blackjack (total equals 21)
-        if (player.getTotal() == 21) {
-            float betadd = (bet * 3) * betMultiplier;
-            cout << fixed << setprecision(2);
-            cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-            cout << "       Blackjack! You win!\n\n";
-            cout << fixed << setprecision(2);
-            cout << "        You made $" << betadd << "!\n";
-            player.setBalance((bet * 3 * betMultiplier) + player.getBalance());
-            cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-            experienceLevel.gainExperience(20 * xpMultiplier);
-            cout << "       - XP +20" << " (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-            cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-            bj = true;
-            turn = false;
-        }
-        // If the player goes over 21 (busts)
-        else if (player.getTotal() > 21) {
-            float betLost = bet;
-            cout << fixed << setprecision(2);
-            cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-            cout << "        Bust! You lose.\n\n";
-            cout << "        You lost $" << bet << "\n";
-            player.setBalance(player.getBalance() - bet);
-            cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-            experienceLevel.gainExperience(-5);
-            cout << "        - XP: -5 (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-            cout << "-=-=-=-=-=-c=-=-=-=-=-=-=-=-=-=-=-\n";
-            bj = true;
-            turn = false;
-        }
     } 
     // If the player chooses to stay
     else if (choice == 'S' or choice == 's') {
         cout << "       You chose to stay.\n";
-        turn = false;
+        engine.apply(Action(ActionType::Stand));
     } 
+    // If the player asks for a hint
+    else if (choice == '?') {
+        displayHint(player, false, hints);
+    }
     // If the player enters an invalid choice
     else {
         cout << "Invalid choice. Please enter 'H' to hit or 'S' to stay.\n";
     }
 }
 
-// This loop manages the dealer's turn in the blackjack game
-int dealerTotal = 0;
-vector<Card> dealerCards;
-
-// Dealer draws cards until their total is at least 17
-while (dealerTotal < 17 && !bj) {
-    addCardToDealer(player, dealerCards, dealerTotal);
-}
-
+// This manages the dealer's turn in the blackjack game
+if (engine.getState() == GameState::DealerTurn) {
+    engine.playDealer();
 
-// Check if the dealer (bj) has not won, indicating that the game is still in progress
-if (!bj) {
     // Display the dealer's cards and game information
     cout << "---------------------------------\n";
     cout << "Dealer's cards:\n";
-    displayCards(dealerCards);
-    cout << "\nDealer Total: " << dealerTotal << "\n";
+    displayCards(engine.getDealerCards());
+    cout << "\nDealer Total: " << engine.getDealerTotal() << "\n";
     cout << "Player Total: " << player.getTotal() << endl;
     cout << "---------------------------------\n";
-
-    // Retrieve multipliers for bet and experience points based on player and experience level
-    float betMultiplier = player.getBetMultiplier();
-    float xpMultiplier = experienceLevel.getXPMultiplier();
-
-    // Check if the dealer has busted (total over 21)
-    if (dealerTotal > 21) {
-        // Calculate winnings, update player's balance, and provide feedback
-        float betadd = (bet * 2) * betMultiplier;
-        cout << fixed << setprecision(2);
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-        cout << "       The dealer busts!\n";
-        cout << "   Congratulations, you win!\n\n";
-        cout << "        You made $" << betadd << "!\n";
-        player.setBalance((bet * 2 * betMultiplier) + player.getBalance());
-        cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-        experienceLevel.gainExperience(10 * xpMultiplier);
-        cout << "       - XP +10 (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-    } else if (dealerTotal > player.getTotal()) {
-        // Handle the case where the dealer wins, deduct bet, and update player's balance
-        cout << fixed << setprecision(2);
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-        cout << "        The dealer wins.\n\n";
-        cout << "        You lost $" << bet << "\n";
-        player.setBalance(player.getBalance() - bet);
-        cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-        experienceLevel.gainExperience(-5);
-        cout << "        - XP: -5 (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-    } else if (dealerTotal == player.getTotal()) {
-        // Handle the case of a tie, update player's balance, and provide feedback
-        cout << fixed << setprecision(2);
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-        cout << "          It's a tie!\n";
-        cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-        experienceLevel.gainExperience(5 * xpMultiplier);
-        cout << "       - XP +5 (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-    } else {
-        // Handle the case where the player wins, calculate winnings, update balance, and provide feedback
-        float betWon = bet * 2 * betMultiplier;
-        cout << fixed << setprecision(2);
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-        cout << "   Congratulations, you win!\n\n";
-        cout << "        You made $" << betWon << "!\n";
-        player.setBalance(betWon + player.getBalance());
-        cout << "  - Your balance is: $" << player.getBalance() << " -\n";
-        experienceLevel.gainExperience(10 * xpMultiplier);
-        cout << "       - XP +10" << " (" << experienceLevel.getExperiencePoints() << "/100) -\n";
-        cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-    }
 }
+
+// Journal the round before reporting how it was settled
+recorder.recordRound(engine);
+displaySettlement(engine.getSettlement());
+
 // Prompt the user for input to play again
 cout << "           Play again?\nEnter 'Y' to continue or 'N' to exit.\n";
 cin >> choice;
@@ -871,54 +1216,15 @@ while (choice != 'Y' && choice != 'y' && choice != 'N' && choice != 'n') {
 
 // If the user chooses to play again, prompt for a shop visit and return the result
 if (choice == 'y' || choice == 'Y') {
-    bool visitedShop = promptForShop(player, shop);
+    bool visitedShop = visitShop(player, shop, recorder);
     return visitedShop;
 } else {
     // If the user chooses not to play again, return false
     return false;
 }
-
-// Alternatively, return the result of the play again choice
-return (choice == 'y' || choice == 'Y');
-}
-
-// Function to save the player's balance to a binary file
-void saveBalance(const Player& player, const string& filename) {
-    ofstream file(filename, ios::binary | ios::out);
-
-    // Check if the file is successfully opened
-    if (file.is_open()) {
-        // Retrieve the player's balance and write it to the file
-        float balance = player.getBalance();
-        file.write(reinterpret_cast<const char*>(&balance), sizeof(balance));
-        file.close();
-    } else {
-        // Display an error message if the file couldn't be opened
-        cout << " Unable to open file for saving balance." << endl;
-    }
-}
-
-// Function to reset the player's balance file to a specified default balance
-void resetBalanceFile(Player& player, const string& filename, float defaultBalance = 100.00) {
-    ofstream file(filename, ios::binary | ios::out);
-
-    // Check if the file is successfully opened
-    if (file.is_open()) {
-        // Set the player's balance to the default value and write it to the file
-        player.setBalance(defaultBalance);
-        float balance = player.getBalance();
-        file.write(reinterpret_cast<const char*>(&balance), sizeof(balance));
-        file.close();
-
-        // Display a message indicating the successful reset and the new default balance
-        cout << " Balance file reset to: $" << defaultBalance << endl;
-    } else {
-        // Display an error message if the file couldn't be opened for resetting
-        cout << " Unable to open file for resetting balance." << endl;
-    }
 }
 
-// Function to load the player's balance from a binary file
+// Function to load the player's balance from a binary file (the format before profile.bin)
 void loadBalance(Player& player, const string& filename) {
     ifstream file(filename, ios::binary | ios::in);
 
@@ -938,24 +1244,1544 @@ void loadBalance(Player& player, const string& filename) {
     }
 }
 
-int main() {
-    // Initialize random seed
-    srand(time(0));
+// Function to copy everything that is saved about the player into a profile record, which includes
+// the journal up to the given entry
+ProfileRecord makeProfile(const Player& player, const ExperienceLevel& experienceLevel, uint32_t journalSequence) {
+    ProfileRecord record;
+    record.journalSequence = journalSequence;
+    record.balance = player.getBalance();
+    record.level = experienceLevel.getLevel();
+    record.experiencePoints = experienceLevel.getExperiencePoints();
+    record.xpMultiplier = player.getXPMultiplier();
+    record.betMultiplier = player.getBetMultiplier();
+    record.doubleDown = player.getDoubleDown();
+    return record;
+}
+
+// Function to restore the player from a profile record
+void applyProfile(const ProfileRecord& record, Player& player, ExperienceLevel& experienceLevel) {
+    player.setBalance(record.balance);
+    player.setXPMultiplier(record.xpMultiplier);
+    player.setBetMultiplier(record.betMultiplier);
+    player.setDoubleDown(record.doubleDown != 0);
+    experienceLevel.setLevel(record.level);
+    experienceLevel.setExperiencePoints(record.experiencePoints);
+}
+
+// Function to redo a journal entry on top of the profile it was recorded after
+void applyJournalEntry(const JournalEntry& entry, Player& player, ExperienceLevel& experienceLevel) {
+    if (entry.kind == JOURNAL_ROUND) {
+        experienceLevel.gainExperience(entry.xpAwarded, false);
+        if (entry.actions & JOURNAL_DOUBLED_DOWN) {
+            player.setDoubleDown(true);
+        }
+    } else if (entry.kind == JOURNAL_RESET) {
+        experienceLevel = ExperienceLevel();
+        player.setDoubleDown(false);
+    }
+    player.setBalance(entry.balance);
+    player.setXPMultiplier(entry.xpMultiplier);
+    player.setBetMultiplier(entry.betMultiplier);
+}
+
+// Function to load the player's profile: the last snapshot, then every journal entry after it.
+// The first time, the balance and level saved by earlier versions in balance.bin and experience.bin
+// are imported into it if importOldFiles is set; they belong to the player without an account name.
+// Once the loaded profile is saved and synced the journal is emptied, so the next start only
+// replays what this session plays.
+void loadProfile(ProfileStore& profile, const string& profileName, bool importOldFiles, RoundJournal& journal,
+                 Player& player, ExperienceLevel& experienceLevel) {
+    ProfileRecord record;
+    if (profile.load(record)) {
+        applyProfile(record, player, experienceLevel);
+        long long replayed = journal.replay(record.journalSequence, [&](const JournalEntry& entry) {
+            applyJournalEntry(entry, player, experienceLevel);
+        });
+        cout << " Profile loaded from " << profileName << endl;
+        if (replayed == 0) {
+            // The snapshot on the disk already covers the whole journal
+            journal.truncate();
+            return;
+        }
+        cout << " Replayed " << replayed << " entries from " << journal.getPath() << endl;
+    } else {
+        // A journal without its profile has nothing to apply to; new entries just continue its numbering
+        journal.replay(0, [](const JournalEntry&) {});
+
+        bool imported = false;
+        if (importOldFiles && ifstream("balance.bin")) {
+            loadBalance(player, "balance.bin");
+            imported = true;
+        }
+        if (importOldFiles && ifstream("experience.bin")) {
+            experienceLevel.loadExperience("experience.bin");
+            imported = true;
+        }
+        if (imported) {
+            cout << " Imported into " << profileName << endl;
+        } else {
+            cout << " No saved profile found. Using default balance and level." << endl;
+        }
+    }
+    if (!profile.save(makeProfile(player, experienceLevel, journal.getSequence())) || !profile.sync()) {
+        cout << " Unable to save profile to " << profileName << endl;
+    } else {
+        journal.truncate();
+    }
+}
+
+// Function to reset the player's profile to a new player's balance, level and multipliers
+void resetProfile(ProfileRecorder& recorder, Player& player, ExperienceLevel& experienceLevel, float defaultBalance = 100.00) {
+    float balanceChange = defaultBalance - player.getBalance();
+    player.setBalance(defaultBalance);
+    player.setXPMultiplier(1.0);
+    player.setBetMultiplier(1.0);
+    player.setDoubleDown(false);
+    experienceLevel = ExperienceLevel();
+    recorder.recordChange(JOURNAL_RESET, balanceChange);
+    cout << " Profile reset to: $" << defaultBalance << ", Level: " << experienceLevel.getLevel() << endl;
+}
+
+// Aggregate results of a headless simulation run
+struct SimulationStats {
+    long long rounds = 0;        // Number of rounds played
+    long long wins = 0;          // Rounds won (including every 21)
+    long long ties = 0;          // Rounds tied with the dealer
+    long long losses = 0;        // Rounds lost to the dealer's higher total
+    long long busts = 0;         // Rounds lost by going over 21
+    double balanceChange = 0.0;  // Net change of the player's balance
+    double wagered = 0.0;        // Total of the bets settled, after doubling down
+    long long xpGained = 0;      // Net experience points awarded
+    long long heapAllocations = 0;  // Heap allocations made while rounds were being played
+    double meanReturn = 0.0;     // Running mean of the balance change per unit bet
+    double sumSquares = 0.0;     // Running sum of squared deviations from meanReturn
+
+    // Adds one round's balance change per unit bet to the running mean and variance
+    void addReturn(double unitReturn) {
+        double delta = unitReturn - meanReturn;
+        meanReturn += delta / rounds;
+        sumSquares += delta * (unitReturn - meanReturn);
+    }
+
+    // Merges the statistics of another batch of rounds into this one
+    void merge(const SimulationStats& other) {
+        if (other.rounds == 0) {
+            return;
+        }
+        long long total = rounds + other.rounds;
+        double delta = other.meanReturn - meanReturn;
+        meanReturn += delta * other.rounds / total;
+        sumSquares += other.sumSquares + delta * delta * rounds * other.rounds / total;
+        rounds = total;
+        wins += other.wins;
+        ties += other.ties;
+        losses += other.losses;
+        busts += other.busts;
+        balanceChange += other.balanceChange;
+        wagered += other.wagered;
+        xpGained += other.xpGained;
+        heapAllocations += other.heapAllocations;
+    }
+
+    // Sample variance of the balance change per unit bet
+    double variance() const {
+        return rounds > 1 ? sumSquares / (rounds - 1) : 0.0;
+    }
+};
+
+// Interface for the decisions a player makes during a round, so rounds can be played without the console
+class DecisionPolicy {
+public:
+    virtual ~DecisionPolicy() {}
+
+    // Returns the amount to bet, between $5.00 and the level's betting limit
+    virtual float chooseBet(const Player& player, const ExperienceLevel& experienceLevel) = 0;
+
+    // Returns true to double down on the initial two cards
+    virtual bool doubleDown(const Player& player) = 0;
+
+    // Returns true to hit, false to stay
+    virtual bool hit(const Player& player) = 0;
+};
+
+// Policy that bets the minimum, never doubles down and hits below 17 like the dealer
+class DealerPolicy : public DecisionPolicy {
+public:
+    float chooseBet(const Player&, const ExperienceLevel&) override {
+        return 5.0;
+    }
+
+    bool doubleDown(const Player&) override {
+        return false;
+    }
+
+    bool hit(const Player& player) override {
+        return player.getTotal() < 17;
+    }
+};
+
+// Policy that bets the minimum, doubles down on 10 or 11 and only hits when it cannot bust
+class CautiousPolicy : public DecisionPolicy {
+public:
+    float chooseBet(const Player&, const ExperienceLevel&) override {
+        return 5.0;
+    }
+
+    bool doubleDown(const Player& player) override {
+        return player.getTotal() == 10 || player.getTotal() == 11;
+    }
+
+    bool hit(const Player& player) override {
+        return player.getTotal() < 12;
+    }
+};
+
+// Policy that bets the minimum and plays the precomputed strategy table: one array lookup per decision
+class TablePolicy : public DecisionPolicy {
+public:
+    float chooseBet(const Player&, const ExperienceLevel&) override {
+        return 5.0;
+    }
+
+    bool doubleDown(const Player& player) override {
+        return STRATEGY_TABLE.doubleDown(player.getTotal(), player.getCards().isSoft(), player.getBetMultiplier());
+    }
+
+    bool hit(const Player& player) override {
+        return STRATEGY_TABLE.hit(player.getTotal(), player.getCards().isSoft(), player.getBetMultiplier());
+    }
+};
+
+// Policy that bets as much as the level's betting limit and the balance allow and plays the strategy table
+class LimitPolicy : public DecisionPolicy {
+private:
+    TablePolicy table;
+
+public:
+    float chooseBet(const Player& player, const ExperienceLevel& experienceLevel) override {
+        return min(experienceLevel.getBettingLimit(), player.getBalance());
+    }
+
+    bool doubleDown(const Player& player) override {
+        return table.doubleDown(player);
+    }
+
+    bool hit(const Player& player) override {
+        return table.hit(player);
+    }
+};
+
+// Policy that plays the strategy table and raises the bet with the true count: one $5 unit at a true
+// count of 1 or less, one more unit for each point above it, up to 8 units
+class CountingPolicy : public DecisionPolicy {
+private:
+    const Shoe& shoe;
+    TablePolicy table;
+
+public:
+    static constexpr int MAX_UNITS = 8;
+
+    // Constructor: bets are sized from the count of the given shoe
+    CountingPolicy(const Shoe& policyShoe) : shoe(policyShoe) {}
+
+    float chooseBet(const Player&, const ExperienceLevel&) override {
+        int units = static_cast<int>(shoe.getTrueCount());
+        return 5.0f * min(max(units, 1), MAX_UNITS);
+    }
+
+    bool doubleDown(const Player& player) override {
+        return table.doubleDown(player);
+    }
+
+    bool hit(const Player& player) override {
+        return table.hit(player);
+    }
+};
+
+// Plays one round on the engine, asking the policy instead of the console, and records the result
+void simulateRound(GameEngine& engine, DecisionPolicy& policy, SimulationStats& stats) {
+    Player& player = engine.getPlayer();
+    ExperienceLevel& experienceLevel = engine.getExperienceLevel();
+
+    engine.startRound();
+
+    // Clamp the bet into the allowed range the same way the console re-prompts
+    float bet = min(max(policy.chooseBet(player, experienceLevel), 5.0f), experienceLevel.getBettingLimit());
+    engine.apply(Action(ActionType::Bet, bet));
+    engine.apply(Action(policy.doubleDown(player) ? ActionType::DoubleDown : ActionType::NoDoubleDown));
+    while (engine.getState() == GameState::AwaitHitStand) {
+        engine.apply(Action(policy.hit(player) ? ActionType::Hit : ActionType::Stand));
+    }
+    engine.playDealer();
+
+    const Settlement& settlement = engine.getSettlement();
+    stats.rounds++;
+    stats.balanceChange += settlement.balanceChange;
+    stats.wagered += engine.getBet();
+    stats.xpGained += settlement.xpAwarded;
+    stats.addReturn(settlement.balanceChange / bet);
+    switch (settlement.outcome) {
+        case RoundOutcome::Tie:
+            stats.ties++;
+            break;
+        case RoundOutcome::DealerWins:
+            stats.losses++;
+            break;
+        case RoundOutcome::Bust:
+        case RoundOutcome::DoubleDownBust:
+            stats.busts++;
+            break;
+        default:
+            stats.wins++;
+            break;
+    }
+}
+
+// Encodes the round the engine just settled into a hand history chunk. A Card is nothing but its
+// index, so the hands are passed to the history as they are.
+void recordHistory(const GameEngine& engine, HistoryChunk& history) {
+    static_assert(sizeof(Card) == 1, "hands are recorded as arrays of card indexes");
+    const Settlement& settlement = engine.getSettlement();
+    const Hand& playerCards = engine.getPlayer().getCards();
+    const Hand& dealerCards = engine.getDealerCards();
+    HistoryRound round;
+    round.playerCards = reinterpret_cast<const uint8_t*>(playerCards.begin());
+    round.playerCount = playerCards.size();
+    round.dealerCards = reinterpret_cast<const uint8_t*>(dealerCards.begin());
+    round.dealerCount = dealerCards.size();
+    round.upcard = static_cast<uint8_t>(engine.getUpcard().getIndex());
+    round.doubledDown = settlement.doubledDown;
+    round.stood = !settlement.doubledDown && dealerCards.size() > 0;
+    round.outcome = static_cast<int>(settlement.outcome);
+    round.xpAwarded = settlement.xpAwarded;
+    round.bet = engine.getBet();
+    history.add(round);
+}
+
+// Adds the round the engine just settled to a chunk of the columnar export
+void exportRound(const GameEngine& engine, ExportChunk& columns) {
+    const Settlement& settlement = engine.getSettlement();
+    columns.add(engine.getBet(), engine.getPlayer().getCards().total(), engine.getDealerCards().total(),
+                static_cast<int>(settlement.outcome), settlement.balanceChange, settlement.balance, settlement.level);
+}
+
+// Policy that bets the minimum and picks the action with the highest exact expected value
+// for the cards left in the shoe
+class OptimalPolicy : public DecisionPolicy {
+private:
+    const Shoe& shoe;
+    EVCalculator calculator;
+
+public:
+    // Constructor: decisions are based on the composition of the given shoe
+    OptimalPolicy(const Shoe& policyShoe) : shoe(policyShoe) {}
+
+    float chooseBet(const Player&, const ExperienceLevel&) override {
+        return 5.0;
+    }
+
+    bool doubleDown(const Player& player) override {
+        if (player.getTotal() >= 21) {
+            return false;
+        }
+        ActionValues values = calculator.evaluate(shoe.getComposition(), player.getTotal(), player.getCards().isSoft());
+        return values.doubleDown > max(values.hit, values.stand);
+    }
+
+    bool hit(const Player& player) override {
+        ActionValues values = calculator.evaluate(shoe.getComposition(), player.getTotal(), player.getCards().isSoft());
+        return values.hit > values.stand;
+    }
+};
+
+// Creates the decision policy with the given name ("dealer", "cautious", "table", "limit", "count" or "optimal")
+unique_ptr<DecisionPolicy> makePolicy(const string& name, const Shoe& shoe) {
+    if (name == "cautious") {
+        return unique_ptr<DecisionPolicy>(new CautiousPolicy());
+    }
+    if (name == "table") {
+        return unique_ptr<DecisionPolicy>(new TablePolicy());
+    }
+    if (name == "limit") {
+        return unique_ptr<DecisionPolicy>(new LimitPolicy());
+    }
+    if (name == "count") {
+        return unique_ptr<DecisionPolicy>(new CountingPolicy(shoe));
+    }
+    if (name == "optimal") {
+        return unique_ptr<DecisionPolicy>(new OptimalPolicy(shoe));
+    }
+    return unique_ptr<DecisionPolicy>(new DealerPolicy());
+}
+
+// Rounds are simulated in fixed-size chunks. Every chunk has its own generator stream and its own
+// Player/ExperienceLevel state, so its results only depend on the seed and the chunk index.
+// Stream k is the seeded generator jumped k times.
+const long long SIMULATION_CHUNK_ROUNDS = 1 << 16;
+
+// Settings of a simulation run, taken from the command line
+struct SimulationConfig {
+    long long rounds = 0;          // Total number of rounds to play
+    string policyName = "dealer";  // Decision policy passed to makePolicy
+    string countName = "hi-lo";    // Counting system the shoe keeps the count with
+    unsigned int threadCount = 1;  // Number of worker threads
+    uint64_t seed = 0;             // Seed of the first generator stream
+    int decks = 6;                 // Number of decks in each shoe
+    double penetration = 0.75;     // Fraction of each shoe dealt before reshuffling
+    long long sessions = 0;        // Number of whole sessions to play in session mode
+    long long maxSessionRounds = 1000;  // Rounds after which a session that never went broke stops
+    long long roiTrials = 0;       // Number of paired trials in shop ROI mode
+    long long roiRounds = 500;     // Rounds played after each purchase in shop ROI mode
+    string historyPath;            // File every simulated round is recorded to, if set
+    string exportPath;             // File every simulated round is exported to in columns, if set
+};
+
+// Plays one chunk of rounds from a fresh player and shoe and returns its statistics.
+// Every round is also encoded into the history chunk and added to the export chunk if they are given.
+SimulationStats simulateChunk(Xoshiro256StarStar stream, long long rounds, const SimulationConfig& config,
+                              HistoryChunk* history = nullptr, ExportChunk* columns = nullptr) {
+    Player player;
+    ExperienceLevel experienceLevel;
+    player.setBalance(100.00);
+
+    Shoe shoe(config.decks, config.penetration, stream, findCountingSystem(config.countName.c_str()));
+    GameEngine engine(player, experienceLevel, shoe);
+    unique_ptr<DecisionPolicy> policy = makePolicy(config.policyName, shoe);
+
+    SimulationStats stats;
+    unsigned long long allocationsBefore = ::heapAllocations;
+    for (long long i = 0; i < rounds; i++) {
+        simulateRound(engine, *policy, stats);
+        if (history != nullptr) {
+            recordHistory(engine, *history);
+        }
+        if (columns != nullptr) {
+            exportRound(engine, *columns);
+        }
+    }
+    stats.heapAllocations = ::heapAllocations - allocationsBefore;
+    return stats;
+}
+
+// Plays the requested number of rounds on all worker threads without any prompts and prints the
+// aggregate results. Chunk results are merged in chunk order, so the same seed gives identical
+// results for any number of threads.
+void runSimulation(const SimulationConfig& config) {
+    long long rounds = config.rounds;
+    long long chunkCount = (rounds + SIMULATION_CHUNK_ROUNDS - 1) / SIMULATION_CHUNK_ROUNDS;
+    vector<SimulationStats> chunkStats(chunkCount);
+    atomic<long long> nextChunk(0);
+
+    // One independent generator stream per chunk
+    vector<Xoshiro256StarStar> streams(chunkCount);
+    Xoshiro256StarStar stream(config.seed);
+    for (auto& chunkStream : streams) {
+        chunkStream = stream;
+        stream.jump();
+    }
+
+    // With --record, each chunk's rounds are encoded on the worker and committed to the file in chunk order
+    unique_ptr<HistoryFile> historyFile;
+    if (!config.historyPath.empty()) {
+        historyFile = unique_ptr<HistoryFile>(new HistoryFile(config.historyPath));
+    }
+    // With --export, the same goes for the columnar export
+    unique_ptr<ExportFile> exportFile;
+    if (!config.exportPath.empty()) {
+        exportFile = unique_ptr<ExportFile>(new ExportFile(config.exportPath));
+    }
+
+    // Each worker takes the next unplayed chunk until none are left
+    auto worker = [&]() {
+        unique_ptr<HistoryChunk> history;
+        if (historyFile) {
+            history = unique_ptr<HistoryChunk>(new HistoryChunk(SIMULATION_CHUNK_ROUNDS));
+        }
+        unique_ptr<ExportChunk> columns;
+        if (exportFile) {
+            columns = unique_ptr<ExportChunk>(new ExportChunk(SIMULATION_CHUNK_ROUNDS));
+        }
+        for (long long chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            long long chunkRounds = min(SIMULATION_CHUNK_ROUNDS, rounds - chunk * SIMULATION_CHUNK_ROUNDS);
+            chunkStats[chunk] = simulateChunk(streams[chunk], chunkRounds, config, history.get(), columns.get());
+            if (history) {
+                history->finish();
+                historyFile->commit(chunk, *history);
+                history->clear();
+            }
+            if (columns) {
+                columns->finish();
+                exportFile->commit(chunk, *columns);
+                columns->clear();
+            }
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (unsigned int i = 1; i < config.threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& workerThread : workers) {
+        workerThread.join();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // Deterministic reduction in chunk order
+    SimulationStats stats;
+    for (const auto& chunk : chunkStats) {
+        stats.merge(chunk);
+    }
+
+    double perSecond = elapsed.count() > 0 ? stats.rounds / elapsed.count() : 0.0;
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "       - Simulation Results -\n\n";
+    cout << "  Seed:           " << config.seed << "\n";
+    cout << "  Threads:        " << config.threadCount << "\n";
+    cout << "  Decks:          " << config.decks << "\n";
+    cout << "  Count:          " << findCountingSystem(config.countName.c_str()).name << "\n";
+    cout << "  Rounds played:  " << stats.rounds << "\n";
+    cout << "  Rounds/second:  " << perSecond << "\n";
+    cout << "  Balance change: $" << stats.balanceChange << "\n";
+    cout << "  Average bet:    $" << stats.wagered / stats.rounds << "\n";
+    cout << "  XP gained:      " << stats.xpGained << "\n";
+    cout << "  Wins:           " << stats.wins << "\n";
+    cout << "  Ties:           " << stats.ties << "\n";
+    cout << "  Losses:         " << stats.losses << "\n";
+    cout << "  Busts:          " << stats.busts << "\n";
+    cout << setprecision(6);
+    cout << "  Win rate:       " << static_cast<double>(stats.wins) / stats.rounds << "\n";
+    cout << "  EV per $1 bet:  " << stats.meanReturn << "\n";
+    cout << "  Return per $1 wagered: " << stats.balanceChange / stats.wagered << "\n";
+    cout << "  Variance:       " << stats.variance() << "\n";
+    cout << "  XP per round:   " << static_cast<double>(stats.xpGained) / stats.rounds << "\n";
+#ifdef COUNT_ALLOCATIONS
+    cout << "  Heap allocations while playing: " << stats.heapAllocations << "\n";
+#endif
+    if (historyFile) {
+        bool written = historyFile->close();
+        cout << setprecision(2);
+        cout << "  History:        " << historyFile->getBytes() << " bytes, "
+             << historyFile->getBytes() * 8.0 / stats.rounds << " bits/round, in " << historyFile->getPath()
+             << (written ? "" : " (not completely written)") << "\n";
+    }
+    if (exportFile) {
+        bool written = exportFile->close();
+        cout << setprecision(2);
+        cout << "  Export:         " << exportFile->getBytes() << " bytes, "
+             << static_cast<double>(exportFile->getBytes()) / stats.rounds << " bytes/round, in "
+             << exportFile->getPath() << (written ? "" : " (not completely written)") << "\n";
+    }
+    cout << "---------------------------------\n";
+}
+
+// Histogram with a fixed number of equal-width buckets over [lower, upper), on a linear or a
+// logarithmic scale, plus one bucket on each side for values out of range. It never allocates,
+// so any number of values can be streamed into it in constant memory.
+class Histogram {
+public:
+    static constexpr int MAX_BUCKETS = 64;
+
+private:
+    double lower;
+    double upper;
+    int bucketCount;
+    bool logarithmic;
+    long long counts[MAX_BUCKETS + 2] = {};  // [0] below lower, [bucketCount + 1] at or above upper
+    long long total = 0;
+    double sum = 0.0;
+
+    // Position of a value on the histogram's scale, from 0 at lower to 1 at upper
+    double scale(double value) const {
+        if (logarithmic) {
+            return log(value / lower) / log(upper / lower);
+        }
+        return (value - lower) / (upper - lower);
+    }
+
+    // Inverse of scale()
+    double unscale(double position) const {
+        if (logarithmic) {
+            return lower * pow(upper / lower, position);
+        }
+        return lower + position * (upper - lower);
+    }
+
+public:
+    // Constructor: lower must be positive for a logarithmic scale
+    Histogram(double low, double high, int buckets, bool logScale = false)
+        : lower(low), upper(high), bucketCount(min(max(buckets, 1), MAX_BUCKETS)), logarithmic(logScale) {}
+
+    void add(double value) {
+        int bucket;
+        if (value < lower) {
+            bucket = 0;
+        } else if (value >= upper) {
+            bucket = bucketCount + 1;
+        } else {
+            bucket = 1 + min(static_cast<int>(scale(value) * bucketCount), bucketCount - 1);
+        }
+        counts[bucket]++;
+        total++;
+        sum += value;
+    }
+
+    // Adds another histogram with the same buckets
+    void merge(const Histogram& other) {
+        for (int i = 0; i < bucketCount + 2; i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+    }
+
+    double mean() const {
+        return total > 0 ? sum / total : 0.0;
+    }
+
+    // Value below which the given fraction of the values fall, interpolated within its bucket.
+    // Values out of range are reported as the edge of the range.
+    double quantile(double fraction) const {
+        double target = fraction * total;
+        double seen = counts[0];
+        if (seen >= target) {
+            return lower;
+        }
+        for (int bucket = 1; bucket <= bucketCount; bucket++) {
+            if (seen + counts[bucket] >= target) {
+                double within = counts[bucket] > 0 ? (target - seen) / counts[bucket] : 0.0;
+                return unscale((bucket - 1 + within) / bucketCount);
+            }
+            seen += counts[bucket];
+        }
+        return upper;
+    }
+
+    // Number of values at or above the upper end of the range
+    long long getOverflow() const {
+        return counts[bucketCount + 1];
+    }
+
+    long long getTotal() const {
+        return total;
+    }
+};
+
+// Sessions are simulated in chunks the same way rounds are: chunk k plays with stream k
+const long long SESSION_CHUNK = 256;
+
+// Results of a batch of sessions, each played from a fresh $100.00 balance and level 1 until the
+// balance drops below the $5.00 minimum bet or the round cap is reached
+struct SessionStats {
+    long long sessions = 0;  // Sessions played
+    long long ruined = 0;    // Sessions that ended below the minimum bet
+    Histogram lengths;       // Rounds played per session
+    Histogram peaks;         // Highest balance reached per session
+    SimulationStats rounds;  // Every round of every session
+
+    // Constructor: lengths cover 0 to maxRounds, peaks cover $100 to $100,000 on a log scale
+    explicit SessionStats(long long maxRounds = 1)
+        : lengths(0.0, static_cast<double>(maxRounds) + 1.0, 50), peaks(100.0, 100000.0, 60, true) {}
+
+    void merge(const SessionStats& other) {
+        sessions += other.sessions;
+        ruined += other.ruined;
+        lengths.merge(other.lengths);
+        peaks.merge(other.peaks);
+        rounds.merge(other.rounds);
+    }
+};
+
+// Plays one chunk of sessions on a single shoe and returns their statistics
+SessionStats simulateSessionChunk(Xoshiro256StarStar stream, long long sessions, const SimulationConfig& config) {
+    Player player;
+    ExperienceLevel experienceLevel;
+    Shoe shoe(config.decks, config.penetration, stream, findCountingSystem(config.countName.c_str()));
+    GameEngine engine(player, experienceLevel, shoe);
+    unique_ptr<DecisionPolicy> policy = makePolicy(config.policyName, shoe);
+
+    SessionStats stats(config.maxSessionRounds);
+    unsigned long long allocationsBefore = ::heapAllocations;
+    for (long long session = 0; session < sessions; session++) {
+        // Every session starts like a reset balance file: $100.00 and level 1
+        player = Player();
+        player.setBalance(100.00);
+        experienceLevel = ExperienceLevel();
+
+        long long played = 0;
+        double peak = player.getBalance();
+        while (player.getBalance() >= 5 && played < config.maxSessionRounds) {
+            simulateRound(engine, *policy, stats.rounds);
+            peak = max(peak, static_cast<double>(player.getBalance()));
+            played++;
+        }
+
+        stats.sessions++;
+        stats.ruined += player.getBalance() < 5;
+        stats.lengths.add(static_cast<double>(played));
+        stats.peaks.add(peak);
+    }
+    stats.rounds.heapAllocations = ::heapAllocations - allocationsBefore;
+    return stats;
+}
+
+// Plays the requested number of sessions on all worker threads and prints the distribution of
+// session length and peak balance and the probability of ruin. Only the histograms of each chunk
+// are kept, never the sessions themselves, and they are merged in chunk order.
+void runSessions(const SimulationConfig& config) {
+    long long sessions = config.sessions;
+    long long chunkCount = (sessions + SESSION_CHUNK - 1) / SESSION_CHUNK;
+    vector<SessionStats> chunkStats(chunkCount, SessionStats(config.maxSessionRounds));
+    atomic<long long> nextChunk(0);
+
+    // One independent generator stream per chunk
+    vector<Xoshiro256StarStar> streams(chunkCount);
+    Xoshiro256StarStar stream(config.seed);
+    for (auto& chunkStream : streams) {
+        chunkStream = stream;
+        stream.jump();
+    }
+
+    // Each worker takes the next unplayed chunk until none are left
+    auto worker = [&]() {
+        for (long long chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            long long chunkSessions = min(SESSION_CHUNK, sessions - chunk * SESSION_CHUNK);
+            chunkStats[chunk] = simulateSessionChunk(streams[chunk], chunkSessions, config);
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (unsigned int i = 1; i < config.threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& workerThread : workers) {
+        workerThread.join();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // Deterministic reduction in chunk order
+    SessionStats stats(config.maxSessionRounds);
+    for (const auto& chunk : chunkStats) {
+        stats.merge(chunk);
+    }
+
+    // Ruin probability with a normal-approximation 95% confidence interval
+    double ruin = static_cast<double>(stats.ruined) / stats.sessions;
+    double margin = 1.96 * sqrt(ruin * (1.0 - ruin) / stats.sessions);
+    double perSecond = elapsed.count() > 0 ? stats.sessions / elapsed.count() : 0.0;
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "        - Session Results -\n\n";
+    cout << "  Seed:           " << config.seed << "\n";
+    cout << "  Threads:        " << config.threadCount << "\n";
+    cout << "  Decks:          " << config.decks << "\n";
+    cout << "  Policy:         " << config.policyName << "\n";
+    cout << "  Sessions:       " << stats.sessions << "\n";
+    cout << "  Sessions/second: " << perSecond << "\n";
+    cout << "  Round cap:      " << config.maxSessionRounds << "\n";
+    cout << "  Rounds played:  " << stats.rounds.rounds << "\n";
+    cout << setprecision(4);
+    cout << "  Ruin probability: " << ruin << " +/- " << margin << "\n";
+    cout << "  Reached the cap:  " << stats.sessions - stats.ruined << "\n";
+    cout << setprecision(1);
+    cout << "\n  Session length (rounds)\n";
+    cout << "    mean " << stats.lengths.mean() << "   p10 " << stats.lengths.quantile(0.10)
+         << "   p50 " << stats.lengths.quantile(0.50) << "   p90 " << stats.lengths.quantile(0.90) << "\n";
+    cout << setprecision(2);
+    cout << "\n  Peak balance\n";
+    cout << "    mean $" << stats.peaks.mean() << "   p10 $" << stats.peaks.quantile(0.10)
+         << "   p50 $" << stats.peaks.quantile(0.50) << "   p90 $" << stats.peaks.quantile(0.90) << "\n";
+    cout << "    p99 $" << stats.peaks.quantile(0.99) << "   over $100000.00: " << stats.peaks.getOverflow() << "\n";
+#ifdef COUNT_ALLOCATIONS
+    cout << "\n  Heap allocations while playing: " << stats.rounds.heapAllocations << "\n";
+#endif
+    cout << "---------------------------------\n";
+}
+
+// Shop items in menu order: options 1-3 are the XP multipliers and 4-6 the bet multipliers
+const int SHOP_ITEMS = 6;
+const int FIRST_BET_ITEM = 3;
+const char* const SHOP_ITEM_NAMES[SHOP_ITEMS] = {"1.5x XP Multiplier", "2x XP Multiplier", "3x XP Multiplier",
+                                                 "1.5x Bet Multiplier", "2x Bet Multiplier", "3x Bet Multiplier"};
+
+// Every ROI run starts with enough to buy any item and still play
+const float ROI_START_BALANCE = 400.00;
+
+// ROI trials are simulated in chunks the same way rounds are: chunk k plays with stream k
+const long long ROI_CHUNK = 64;
+
+// Balance differences between runs with and without each shop item, summed over paired trials
+// for every round of the horizon
+struct RoiStats {
+    long long trials = 0;
+    vector<double> sums[SHOP_ITEMS];     // [item][round] sum of (with item - without) balances
+    vector<double> squares[SHOP_ITEMS];  // [item][round] sum of squared differences
+    double cost[SHOP_ITEMS] = {};        // Price the shop took for each item
+    float effect[SHOP_ITEMS] = {};       // Multiplier each item actually leaves the player with
+    double baseSum = 0.0;                // Final balance without any item
+    double baseSquares = 0.0;
+    double itemSum[SHOP_ITEMS] = {};     // Final balance with each item
+    double itemSquares[SHOP_ITEMS] = {};
+
+    // Constructor: one entry per round from 0 (right after the purchase) to rounds
+    explicit RoiStats(long long rounds = 0) {
+        for (int item = 0; item < SHOP_ITEMS; item++) {
+            sums[item].assign(rounds + 1, 0.0);
+            squares[item].assign(rounds + 1, 0.0);
+        }
+    }
+
+    void merge(const RoiStats& other) {
+        trials += other.trials;
+        for (int item = 0; item < SHOP_ITEMS; item++) {
+            for (size_t round = 0; round < sums[item].size(); round++) {
+                sums[item][round] += other.sums[item][round];
+                squares[item][round] += other.squares[item][round];
+            }
+            cost[item] = other.cost[item];
+            effect[item] = other.effect[item];
+            itemSum[item] += other.itemSum[item];
+            itemSquares[item] += other.itemSquares[item];
+        }
+        baseSum += other.baseSum;
+        baseSquares += other.baseSquares;
+    }
+};
+
+// Plays one ROI run: buys the bet multiplier option (0 for none) through Shop, then plays the given
+// number of rounds and records the balance after each one. Runs given the same stream are dealt the
+// same shoe, so a run with an item and a run without it see the same cards.
+void playRoiRun(Xoshiro256StarStar stream, int option, const SimulationConfig& config, vector<float>& balances,
+                float& effect) {
+    Player player;
+    ExperienceLevel experienceLevel;
+    Shop shop;
+    player.setBalance(ROI_START_BALANCE);
+    if (option > FIRST_BET_ITEM) {
+        shop.purchaseBetMultiplier(player, option - FIRST_BET_ITEM);
+        effect = player.getBetMultiplier();
+    }
+
+    Shoe shoe(config.decks, config.penetration, stream, findCountingSystem(config.countName.c_str()));
+    GameEngine engine(player, experienceLevel, shoe);
+    unique_ptr<DecisionPolicy> policy = makePolicy(config.policyName, shoe);
+    SimulationStats stats;
+
+    balances[0] = player.getBalance();
+    for (size_t round = 1; round < balances.size(); round++) {
+        simulateRound(engine, *policy, stats);
+        balances[round] = player.getBalance();
+    }
+}
+
+// Plays one chunk of paired trials. Each trial deals its own shoe for the run without an item and
+// the same shoe again for each of the bet multipliers.
+RoiStats simulateRoiChunk(Xoshiro256StarStar stream, long long trials, const SimulationConfig& config) {
+    RoiStats stats(config.roiRounds);
+    vector<float> base(config.roiRounds + 1);
+    vector<float> withItem(config.roiRounds + 1);
+    float unused = 1.0f;
+
+    for (long long trial = 0; trial < trials; trial++) {
+        // Each trial's shoe is seeded from the chunk's stream
+        Xoshiro256StarStar trialStream(stream.next());
+        playRoiRun(trialStream, 0, config, base, unused);
+        stats.baseSum += base.back();
+        stats.baseSquares += static_cast<double>(base.back()) * base.back();
+
+        for (int item = FIRST_BET_ITEM; item < SHOP_ITEMS; item++) {
+            playRoiRun(trialStream, item + 1, config, withItem, stats.effect[item]);
+            stats.cost[item] = ROI_START_BALANCE - withItem[0];
+            for (size_t round = 0; round < base.size(); round++) {
+                double difference = static_cast<double>(withItem[round]) - base[round];
+                stats.sums[item][round] += difference;
+                stats.squares[item][round] += difference * difference;
+            }
+            stats.itemSum[item] += withItem.back();
+            stats.itemSquares[item] += static_cast<double>(withItem.back()) * withItem.back();
+        }
+        stats.trials++;
+    }
+    return stats;
+}
+
+// Sample variance from a sum and a sum of squares over count values
+double sampleVariance(double sum, double squares, long long count) {
+    if (count < 2) {
+        return 0.0;
+    }
+    return max((squares - sum * sum / count) / (count - 1), 0.0);
+}
+
+// Measures whether each bet multiplier pays for itself. Every trial plays the same cards with and without
+// the item (common random numbers), so the difference between the two runs only reflects the item
+// and needs far fewer trials than comparing independent runs. The break-even round is the first
+// round where the mean difference is no longer negative; its interval runs from the first round the
+// 95% interval of the difference reaches zero to the first round it is entirely above zero.
+void runShopRoi(const SimulationConfig& config) {
+    long long trials = config.roiTrials;
+    long long chunkCount = (trials + ROI_CHUNK - 1) / ROI_CHUNK;
+    vector<RoiStats> chunkStats(chunkCount);
+    atomic<long long> nextChunk(0);
+
+    // One independent generator stream per chunk
+    vector<Xoshiro256StarStar> streams(chunkCount);
+    Xoshiro256StarStar stream(config.seed);
+    for (auto& chunkStream : streams) {
+        chunkStream = stream;
+        stream.jump();
+    }
+
+    // Each worker takes the next unplayed chunk until none are left
+    auto worker = [&]() {
+        for (long long chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            long long chunkTrials = min(ROI_CHUNK, trials - chunk * ROI_CHUNK);
+            chunkStats[chunk] = simulateRoiChunk(streams[chunk], chunkTrials, config);
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned int i = 1; i < config.threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& workerThread : workers) {
+        workerThread.join();
+    }
+
+    // Deterministic reduction in chunk order
+    RoiStats stats(config.roiRounds);
+    for (const auto& chunk : chunkStats) {
+        stats.merge(chunk);
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "       - Shop Purchase ROI -\n\n";
+    cout << "  Seed:           " << config.seed << "\n";
+    cout << "  Policy:         " << config.policyName << "\n";
+    cout << "  Paired trials:  " << stats.trials << "\n";
+    cout << "  Rounds each:    " << config.roiRounds << "\n";
+    cout << "  Start balance:  $" << ROI_START_BALANCE << "\n\n";
+
+    for (int item = 0; item < SHOP_ITEMS; item++) {
+        // The game awards XP with the level's multiplier, which XP items do not change, so they are
+        // only priced and not played
+        if (item < FIRST_BET_ITEM) {
+            Player buyer;
+            Shop shop;
+            buyer.setBalance(ROI_START_BALANCE);
+            shop.purchaseXPMultiplier(buyer, item + 1);
+            cout << "  " << item + 1 << ". " << SHOP_ITEM_NAMES[item] << " ($" << ROI_START_BALANCE - buyer.getBalance()
+                 << ")\n";
+            cout << "     No effect in the game: XP is awarded with the level's multiplier, which this item does not change\n";
+            continue;
+        }
+
+        long long breakEven = -1;
+        long long earliest = -1;
+        long long latest = -1;
+        for (long long round = 0; round <= config.roiRounds; round++) {
+            double mean = stats.sums[item][round] / stats.trials;
+            double variance = sampleVariance(stats.sums[item][round], stats.squares[item][round], stats.trials);
+            double margin = 1.96 * sqrt(variance / stats.trials);
+            if (breakEven < 0 && mean >= 0) {
+                breakEven = round;
+            }
+            if (earliest < 0 && mean + margin >= 0) {
+                earliest = round;
+            }
+            if (latest < 0 && mean - margin > 0) {
+                latest = round;
+            }
+        }
+
+        long long last = config.roiRounds;
+        double gain = stats.sums[item][last] / stats.trials;
+        double pairedError = sqrt(sampleVariance(stats.sums[item][last], stats.squares[item][last], stats.trials)
+                                  / stats.trials);
+        double independentError = sqrt((sampleVariance(stats.baseSum, stats.baseSquares, stats.trials)
+                                        + sampleVariance(stats.itemSum[item], stats.itemSquares[item], stats.trials))
+                                       / stats.trials);
+
+        cout << "  " << item + 1 << ". " << SHOP_ITEM_NAMES[item] << " ($" << stats.cost[item]
+             << ", sets bet multiplier to " << stats.effect[item] << "x)\n";
+        cout << "     Break-even round: ";
+        if (breakEven < 0) {
+            cout << "never within " << last;
+        } else {
+            cout << breakEven;
+        }
+        cout << "   95% interval: " << (earliest < 0 ? string("never") : to_string(earliest)) << " - "
+             << (latest < 0 ? string("never") : to_string(latest)) << "\n";
+        cout << "     Gain after " << last << " rounds: $" << gain << " +/- " << 1.96 * pairedError
+             << "   (independent runs: +/- " << 1.96 * independentError << ")\n";
+    }
+    cout << "---------------------------------\n";
+}
+
+// Times saving many profiles, each in its own file, as when many tables settle at once. Every pass
+// saves every profile once: first the way saveBalance and saveExperience used to, opening, writing
+// and closing both files of each player with ofstream, then with one pwrite per profile file, and
+// then in batches through each batch backend. The files are made in a scratch directory under /tmp.
+void runStorageBenchmark(int profiles, int passes) {
+    char directory[] = "/tmp/blackjack-storage-XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        cout << "Unable to create a directory for the storage benchmark\n";
+        return;
+    }
+    string base = directory;
+    vector<unique_ptr<ProfileFile>> files;
+    for (int i = 0; i < profiles; i++) {
+        files.push_back(unique_ptr<ProfileFile>(new ProfileFile(base + "/profile" + to_string(i) + ".bin")));
+    }
+
+    vector<unique_ptr<BatchBackend>> backends;
+    backends.push_back(unique_ptr<BatchBackend>(new PwriteBackend()));
+#ifdef HAVE_IO_URING
+    unique_ptr<IoUringBackend> uring(new IoUringBackend());
+    if (uring->isOpen()) {
+        backends.push_back(unique_ptr<BatchBackend>(uring.release()));
+    }
+#endif
+
+    // Runs the given way of saving every profile once per pass and prints the saves per second
+    ProfileRecord record;
+    bool allSaved = true;
+    auto measure = [&](const string& label, auto saveAll) {
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) {
+            record.balance = 100.0f + pass;
+            allSaved = saveAll() && allSaved;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  " << left << setw(34) << label << right << setw(12) << static_cast<long long>(profiles * passes / seconds)
+             << " saves/s\n";
+    };
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "       - Storage Benchmark -\n\n";
+    cout << "  Profiles:       " << profiles << ", one file each\n";
+    cout << "  Passes:         " << passes << "\n\n";
+
+    measure("ofstream, 2 files per profile", [&] {
+        bool ok = true;
+        for (int i = 0; i < profiles; i++) {
+            ofstream balanceFile(base + "/balance" + to_string(i) + ".bin", ios::binary | ios::out);
+            balanceFile.write(reinterpret_cast<const char*>(&record.balance), sizeof(record.balance));
+            balanceFile.close();
+            ofstream experienceFile(base + "/experience" + to_string(i) + ".bin", ios::binary | ios::out);
+            experienceFile.write(reinterpret_cast<const char*>(&record.level), sizeof(record.level));
+            experienceFile.write(reinterpret_cast<const char*>(&record.experiencePoints), sizeof(record.experiencePoints));
+            experienceFile.close();
+            ok = ok && balanceFile && experienceFile;
+        }
+        return ok;
+    });
+    measure("pwrite per profile", [&] {
+        bool ok = true;
+        for (int i = 0; i < profiles; i++) {
+            ok = files[i]->save(record) && ok;
+        }
+        return ok;
+    });
+    for (bool sync : {false, true}) {
+        if (sync) {
+            measure("pwrite + fsync per profile", [&] {
+                bool ok = true;
+                for (int i = 0; i < profiles; i++) {
+                    ok = files[i]->save(record) && files[i]->sync() && ok;
+                }
+                return ok;
+            });
+        }
+        for (const unique_ptr<BatchBackend>& backend : backends) {
+            ProfileBatch batch(*backend);
+            measure(string("batch, ") + backend->name() + (sync ? " + fsync" : ""), [&] {
+                for (int i = 0; i < profiles; i++) {
+                    batch.add(*files[i], record);
+                }
+                return batch.flush(sync);
+            });
+        }
+    }
+    if (backends.size() == 1) {
+        cout << "  (io_uring is not available here; batches fall back to pwrite)\n";
+    }
+    if (!allSaved) {
+        cout << "  Some saves failed\n";
+    }
+    cout << "---------------------------------\n";
+
+    files.clear();
+    for (int i = 0; i < profiles; i++) {
+        for (const char* name : {"/profile", "/balance", "/experience"}) {
+            remove((base + name + to_string(i) + ".bin").c_str());
+        }
+    }
+    rmdir(directory);
+}
+
+// Solves the XP progression chain for the strategy table's round outcomes and prints how many rounds
+// it takes to reach each level up to the target
+void printXPModel(int targetLevel, float xpMultiplier) {
+    auto start = chrono::steady_clock::now();
+    XPOutcomes outcomes = TableOutcomes(STRATEGY_TABLE).solve();
+    XPProgression progression(outcomes, xpMultiplier, targetLevel);
+    progression.solve();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+    cout << fixed << setprecision(4);
+    cout << "---------------------------------\n";
+    cout << "      - XP Progression Model -\n\n";
+    cout << "  Strategy table, infinite deck, " << setprecision(2) << xpMultiplier << "x XP\n";
+    cout << "  Chance of each award per round:\n   ";
+    cout << setprecision(4);
+    for (int award = 0; award < XP_AWARDS; award++) {
+        cout << " " << showpos << XP_AWARD_POINTS[award] << noshowpos << ": " << outcomes.probability[award];
+    }
+    cout << "\n\n";
+    cout << "  Level  Expected rounds    p10    p50    p90\n";
+    for (int level = 2; level <= progression.getTargetLevel(); level++) {
+        cout << "  " << setw(5) << level << setprecision(1) << setw(17) << progression.expectedRounds(level)
+             << setw(7) << progression.quantile(level, 0.10) << setw(7) << progression.quantile(level, 0.50)
+             << setw(7) << progression.quantile(level, 0.90) << "\n";
+    }
+    cout << "\n  Rounds solved:  " << progression.getRounds() << "\n";
+    cout << setprecision(2);
+    cout << "  Solved in:      " << elapsed.count() << " ms\n";
+    cout << "---------------------------------\n";
+}
+
+// Names of the round outcomes in RoundOutcome order, for the history reports
+const char* const OUTCOME_NAMES[HISTORY_OUTCOMES] = {"Double down 21", "Double down bust", "First try 21",
+                                                     "21 after hitting", "Bust", "Dealer bust", "Dealer wins",
+                                                     "Tie", "Player wins"};
+
+// Reads a hand history back and prints a summary of the rounds in it
+void printHistory(const string& path) {
+
+    HistoryReader reader(path);
+    if (!reader.isValid()) {
+        cout << "Unable to read a hand history from " << path << "\n";
+        return;
+    }
+    long long outcomes[HISTORY_OUTCOMES] = {};
+    long long doubledDown = 0;
+    long long playerCards = 0;
+    long long dealerCards = 0;
+    long long xp = 0;
+    double wagered = 0.0;
+    auto start = chrono::steady_clock::now();
+    long long rounds = reader.forEach([&](const HistoryRound& round) {
+        outcomes[min(max(round.outcome, 0), HISTORY_OUTCOMES - 1)]++;
+        doubledDown += round.doubledDown;
+        playerCards += round.playerCount;
+        dealerCards += round.dealerCount;
+        xp += round.xpAwarded;
+        wagered += round.bet;
+    });
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    if (rounds == 0) {
+        cout << "No rounds in " << path << "\n";
+        return;
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "        - Hand History -\n\n";
+    cout << "  Rounds:         " << rounds << "\n";
+    cout << "  Rounds/second:  " << rounds / max(elapsed.count(), 1e-9) << " read\n";
+    cout << "  Average bet:    $" << wagered / rounds << "\n";
+    cout << "  XP gained:      " << xp << "\n";
+    cout << "  Doubled down:   " << doubledDown << "\n";
+    cout << "  Player cards:   " << static_cast<double>(playerCards) / rounds << " per round\n";
+    cout << "  Dealer cards:   " << static_cast<double>(dealerCards) / rounds << " per round\n\n";
+    for (int outcome = 0; outcome < HISTORY_OUTCOMES; outcome++) {
+        cout << "  " << left << setw(18) << OUTCOME_NAMES[outcome] << right << setw(12) << outcomes[outcome] << "\n";
+    }
+    cout << "---------------------------------\n";
+}
+
+// Scans the requested columns of an export one at a time and prints how each is stored and a
+// summary of its values. columnList is a comma-separated list of column names; empty means all.
+void printExport(const string& path, const string& columnList) {
+    ExportReader reader(path);
+    if (!reader.isValid()) {
+        cout << "Unable to read an export from " << path << "\n";
+        return;
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "        - Columnar Export -\n\n";
+    cout << "  " << left << setw(14) << "Column" << right << setw(12) << "Bytes" << setw(10) << "B/round"
+         << setw(12) << "Min" << setw(12) << "Max" << setw(12) << "Mean" << "   Encodings\n";
+    for (int column = 0; column < EXPORT_COLUMNS; column++) {
+        string name = EXPORT_COLUMN_NAMES[column];
+        if (!columnList.empty() && ("," + columnList + ",").find("," + name + ",") == string::npos) {
+            continue;
+        }
+        long long encodings[ENCODINGS] = {};
+        long long bytes = 0;
+        int64_t low = INT64_MAX;
+        int64_t high = INT64_MIN;
+        double sum = 0.0;
+        long long rounds = reader.scan(column, [&](const ColumnBlock& block) {
+            encodings[block.encoding < ENCODINGS ? block.encoding : static_cast<uint8_t>(ENCODING_PLAIN)]++;
+            bytes += block.bytes;
+            for (uint32_t row = 0; row < block.rounds; row++) {
+                low = min(low, block.values[row]);
+                high = max(high, block.values[row]);
+                sum += block.values[row];
+            }
+        });
+        if (rounds == 0) {
+            cout << "  " << left << setw(14) << name << right << "  no rounds\n";
+            continue;
+        }
+        double scale = EXPORT_COLUMN_SCALE[column];
+        cout << "  " << left << setw(14) << name << right << setw(12) << bytes
+             << setw(10) << static_cast<double>(bytes) / rounds << setw(12) << low / scale
+             << setw(12) << high / scale << setw(12) << sum / rounds / scale << "  ";
+        for (int encoding = 0; encoding < ENCODINGS; encoding++) {
+            if (encodings[encoding] > 0) {
+                cout << " " << ENCODING_NAMES[encoding] << " x" << encodings[encoding];
+            }
+        }
+        cout << "\n";
+    }
+    cout << "---------------------------------\n";
+}
+
+// Reads a situation such as "soft 17 vs 10 hit" into a query. Every part is optional: "soft" or
+// "hard", the total, "vs" and the dealer's card (A or 2-10), and "hit", "stand" or "double".
+// Returns false for a word it does not know.
+bool parseSituation(const string& text, SituationQuery& query) {
+    string word;
+    bool upcardNext = false;
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (i < text.size() && !isspace(static_cast<unsigned char>(text[i])) && text[i] != ',') {
+            word += static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
+            continue;
+        }
+        if (word.empty()) {
+            continue;
+        }
+        int number = isdigit(static_cast<unsigned char>(word[0])) ? atoi(word.c_str()) : 0;
+        if (upcardNext) {
+            query.upcard = word == "a" || word == "ace" ? 1 : number;
+            upcardNext = false;
+            if (query.upcard < 1 || query.upcard > 10) {
+                return false;
+            }
+        } else if (word == "vs" || word == "against") {
+            upcardNext = true;
+        } else if (word == "soft" || word == "hard") {
+            query.soft = word == "soft";
+        } else if (word == "hit" || word == "hits") {
+            query.action = SITUATION_HIT;
+        } else if (word == "stand" || word == "stands") {
+            query.action = SITUATION_STAND;
+        } else if (word == "double" || word == "doubles") {
+            query.action = SITUATION_DOUBLE;
+        } else if (number >= 2 && number <= 21) {
+            query.total = number;
+        } else {
+            return false;
+        }
+        word.clear();
+    }
+    return !upcardNext;
+}
+
+// Answers a situation query over a hand history and prints the outcomes of the matching decisions
+void printSituationQuery(const string& path, const string& situation, long long firstRound, long long lastRound) {
+    SituationQuery query;
+    if (!parseSituation(situation, query)) {
+        cout << "Unable to understand the situation \"" << situation << "\"\n";
+        return;
+    }
+    query.firstRound = firstRound;
+    query.lastRound = lastRound;
+
+    auto start = chrono::steady_clock::now();
+    SituationIndex index(path);
+    chrono::duration<double, milli> loaded = chrono::steady_clock::now() - start;
+    if (!index.isValid()) {
+        cout << "Unable to read a hand history from " << path << "\n";
+        return;
+    }
+    start = chrono::steady_clock::now();
+    SituationResult result = index.query(query);
+    chrono::duration<double, milli> answered = chrono::steady_clock::now() - start;
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "       - Situation Query -\n\n";
+    cout << "  Situation:      " << situation << "\n";
+    cout << "  Rounds:         " << index.getRounds() << " recorded, " << index.getIndexedChunks() << " of "
+         << index.getChunks() << " chunks indexed\n";
+    cout << "  Index loaded:   " << loaded.count() << " ms\n";
+    cout << "  Answered in:    " << answered.count() << " ms, " << result.indexRows << " index rows, "
+         << result.decodedRounds << " rounds decoded\n";
+    cout << "  Decisions:      " << result.decisions << "\n\n";
+    if (result.decisions == 0) {
+        cout << "---------------------------------\n";
+        return;
+    }
+    for (int outcome = 0; outcome < HISTORY_OUTCOMES; outcome++) {
+        cout << "  " << left << setw(18) << OUTCOME_NAMES[outcome] << right << setw(12) << result.outcomes[outcome]
+             << setw(9) << 100.0 * result.outcomes[outcome] / result.decisions << "%\n";
+    }
+    long long won = result.decisions - result.outcomes[static_cast<int>(RoundOutcome::Tie)]
+                    - result.outcomes[static_cast<int>(RoundOutcome::DealerWins)]
+                    - result.outcomes[static_cast<int>(RoundOutcome::Bust)]
+                    - result.outcomes[static_cast<int>(RoundOutcome::DoubleDownBust)];
+    cout << "\n  Won:            " << 100.0 * won / result.decisions << "%\n";
+    cout << "  Tied:           " << 100.0 * result.outcomes[static_cast<int>(RoundOutcome::Tie)] / result.decisions << "%\n";
+    cout << "---------------------------------\n";
+}
+
+// Prints one row of dealer outcome probabilities
+void printDealerRow(const string& label, const DealerDistribution& distribution) {
+    cout << "  " << setw(6) << label;
+    for (int i = 0; i < DEALER_RESULTS; i++) {
+        cout << setw(8) << distribution.probability[i] * 100;
+    }
+    cout << "\n";
+}
+
+// Prints the exact probability of each dealer result for every upcard, for an infinite deck
+// and for a full shoe of the given number of decks
+void printDealerOdds(int decks) {
+    const string upcardNames[UPCARDS] = {"none", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10"};
+    DealerOdds dealerOdds;
+
+    cout << fixed << setprecision(2);
+    cout << "---------------------------------\n";
+    cout << "    - Dealer Result Odds (%) -\n";
+    for (int table = 0; table < 2; table++) {
+        if (table == 0) {
+            cout << "\n  Infinite deck:\n";
+        } else {
+            cout << "\n  " << decks << "-deck shoe:\n";
+        }
+        cout << "  Upcard      17      18      19      20      21    Bust\n";
+        for (int upcard = NO_UPCARD; upcard < UPCARDS; upcard++) {
+            if (table == 0) {
+                printDealerRow(upcardNames[upcard], INFINITE_DEALER_ODDS.forUpcard(upcard));
+            } else {
+                ShoeComposition shoe = ShoeComposition::fullShoe(decks);
+                if (upcard != NO_UPCARD) {
+                    shoe.remove(upcard - 1);
+                }
+                printDealerRow(upcardNames[upcard], dealerOdds.forUpcard(shoe, upcard));
+            }
+        }
+    }
+    cout << "---------------------------------\n";
+}
+
+int main(int argc, char* argv[]) {
+    // Headless mode: --simulate N [--policy dealer|cautious|table|limit|count|optimal] [--threads T] [--seed S]
+    // [--count hi-lo|ko|hi-opt-1|omega-2|zen] picks the counting system the "count" policy bets with
+    // Session mode: --sessions N [--max-rounds R] plays N sessions from $100.00 until the balance is
+    // below the minimum bet or R rounds were played, with the same policy, thread and seed options
+    // Shop ROI mode: --shop-roi N [--roi-rounds R] plays N paired trials of R rounds with and without
+    // each bet multiplier; XP items have no effect in the game and are only priced
+    // The shoe can be configured for both modes: [--decks D] [--penetration P]
+    // --dealer-odds prints the exact dealer result probabilities for the configured shoe
+    // --xp-model [--target-level L] [--xp-multiplier M] solves how many rounds each level takes
+    // --sync-ms T sets how often the game's saves are synced to the disk (default 1000)
+    // --record FILE writes a compact hand history of every round, simulated or played, to FILE
+    // --read-history FILE summarises a hand history
+    // --query-history FILE --situation "soft 17 vs 10 hit" [--range FIRST:LAST] counts the outcomes of
+    // the decisions in that situation from the index recorded with the history; leave out any part
+    // of the situation to match every value of it
+    // --export FILE writes every simulated round to FILE in columns: bet, player and dealer totals,
+    // outcome, payout, balance and level
+    // --read-export FILE [--columns a,b,...] scans the named columns of an export (default all)
+    // --bench-storage N [--bench-passes P] times saving N profiles, each in its own file, one by one
+    // and in io_uring or pwrite batches
+    // --player NAME keeps the profile in the account NAME of profiles.bin, which holds any number of
+    // players, with its own journal; without it the profile is profile.bin and the journal journal.bin
+    // --snapshot-every N saves the profile every N journal entries (default 50); the rounds in between
+    // are replayed from journal.bin on startup
+    SimulationConfig config;
+    bool showDealerOdds = false;
+    bool showXPModel = false;
+    int targetLevel = 5;
+    float xpMultiplier = 1.0f;
+    long long syncInterval = 1000;
+    int snapshotInterval = 50;
+    string playerName;
+    int benchProfiles = 0;
+    int benchPasses = 5;
+    string historyToRead;
+    string exportToRead;
+    string historyToQuery;
+    string situation;
+    long long firstRound = 0;
+    long long lastRound = -1;
+    string exportColumns;
+    config.threadCount = max(thread::hardware_concurrency(), 1u);
+    config.seed = time(0);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) {
+            config.rounds = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            config.policyName = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.threadCount = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            config.sessions = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--max-rounds") == 0 && i + 1 < argc) {
+            config.maxSessionRounds = max(atoll(argv[++i]), 1LL);
+        } else if (strcmp(argv[i], "--shop-roi") == 0 && i + 1 < argc) {
+            config.roiTrials = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--roi-rounds") == 0 && i + 1 < argc) {
+            config.roiRounds = max(atoll(argv[++i]), 1LL);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            config.countName = argv[++i];
+        } else if (strcmp(argv[i], "--decks") == 0 && i + 1 < argc) {
+            config.decks = min(max(atoi(argv[++i]), 1), 8);
+        } else if (strcmp(argv[i], "--penetration") == 0 && i + 1 < argc) {
+            config.penetration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dealer-odds") == 0) {
+            showDealerOdds = true;
+        } else if (strcmp(argv[i], "--sync-ms") == 0 && i + 1 < argc) {
+            syncInterval = max(atoll(argv[++i]), 0LL);
+        } else if (strcmp(argv[i], "--bench-storage") == 0 && i + 1 < argc) {
+            benchProfiles = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--bench-passes") == 0 && i + 1 < argc) {
+            benchPasses = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            config.historyPath = argv[++i];
+        } else if (strcmp(argv[i], "--read-history") == 0 && i + 1 < argc) {
+            historyToRead = argv[++i];
+        } else if (strcmp(argv[i], "--query-history") == 0 && i + 1 < argc) {
+            historyToQuery = argv[++i];
+        } else if (strcmp(argv[i], "--situation") == 0 && i + 1 < argc) {
+            situation = argv[++i];
+        } else if (strcmp(argv[i], "--range") == 0 && i + 1 < argc) {
+            const char* range = argv[++i];
+            const char* colon = strchr(range, ':');
+            firstRound = max(atoll(range), 0LL);
+            lastRound = colon != nullptr && colon[1] != '\0' ? atoll(colon + 1) : -1;
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            config.exportPath = argv[++i];
+        } else if (strcmp(argv[i], "--read-export") == 0 && i + 1 < argc) {
+            exportToRead = argv[++i];
+        } else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) {
+            exportColumns = argv[++i];
+        } else if (strcmp(argv[i], "--player") == 0 && i + 1 < argc) {
+            playerName = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot-every") == 0 && i + 1 < argc) {
+            snapshotInterval = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--xp-model") == 0) {
+            showXPModel = true;
+        } else if (strcmp(argv[i], "--target-level") == 0 && i + 1 < argc) {
+            targetLevel = min(max(atoi(argv[++i]), 2), 100);
+        } else if (strcmp(argv[i], "--xp-multiplier") == 0 && i + 1 < argc) {
+            xpMultiplier = atof(argv[++i]);
+        }
+    }
+    if (showDealerOdds) {
+        printDealerOdds(config.decks);
+        return 0;
+    }
+    if (showXPModel) {
+        printXPModel(targetLevel, xpMultiplier);
+        return 0;
+    }
+    if (!historyToRead.empty()) {
+        printHistory(historyToRead);
+        return 0;
+    }
+    if (!historyToQuery.empty()) {
+        printSituationQuery(historyToQuery, situation, firstRound, lastRound);
+        return 0;
+    }
+    if (!exportToRead.empty()) {
+        printExport(exportToRead, exportColumns);
+        return 0;
+    }
+    if (benchProfiles > 0) {
+        runStorageBenchmark(benchProfiles, benchPasses);
+        return 0;
+    }
+    if (config.rounds > 0) {
+        runSimulation(config);
+        return 0;
+    }
+    if (config.sessions > 0) {
+        runSessions(config);
+        return 0;
+    }
+    if (config.roiTrials > 0) {
+        runShopRoi(config);
+        return 0;
+    }
+
+    // The game deals from its own shoe, shuffled with a generator seeded from the clock or --seed
+    Xoshiro256StarStar random(config.seed);
+    Shoe shoe(config.decks, config.penetration, random);
 
     // Create instances of Player, ExperienceLevel, and Shop
     Player player;
     ExperienceLevel experienceLevel;
+    GameEngine engine(player, experienceLevel, shoe);
     Shop shop;
 
+    // Works out hints on a background thread while the game waits for input
+    HintWorker hints;
+
     // Set initial balance for the player
     player.setBalance(100.00);
 
     // Flag to control game continuation
     bool again = true;
 
-    // Load player's balance and experience level from files
-    loadBalance(player, "balance.bin");
-    experienceLevel.loadExperience("experience.bin");
+    // Load player's balance, experience level and multipliers from the profile and the journal
+    // Every round is journaled; snapshots go through a write-behind thread that syncs every --sync-ms milliseconds
+    unique_ptr<ProfileTable> profileTable;
+    unique_ptr<ProfileStore> profile;
+    string profileName = "profile.bin";
+    string journalName = "journal.bin";
+    if (playerName.empty()) {
+        profile = unique_ptr<ProfileStore>(new ProfileFile(profileName));
+    } else {
+        // An account's journal is named after its player id, so any name makes a valid file name
+        uint64_t playerId = playerIdFor(playerName);
+        char idText[17];
+        snprintf(idText, sizeof(idText), "%016llx", static_cast<unsigned long long>(playerId));
+        profileTable = unique_ptr<ProfileTable>(new ProfileTable("profiles.bin"));
+        profile = unique_ptr<ProfileStore>(new ProfileTableEntry(*profileTable, playerId));
+        profileName = "'" + playerName + "' in profiles.bin";
+        journalName = string("journal-") + idText + ".bin";
+    }
+    RoundJournal journal(journalName);
+    loadProfile(*profile, profileName, playerName.empty(), journal, player, experienceLevel);
+    ProfileWriter writer(*profile, chrono::milliseconds(syncInterval));
+    ProfileRecorder recorder(journal, writer, player, experienceLevel, snapshotInterval);
+
+    // With --record the rounds played are also kept in a hand history, written a chunk at a time
+    const uint32_t LIVE_HISTORY_CHUNK_ROUNDS = 1024;
+    unique_ptr<HistoryFile> historyFile;
+    HistoryChunk history;
+    long long historyChunks = 0;
+    if (!config.historyPath.empty()) {
+        historyFile = unique_ptr<HistoryFile>(new HistoryFile(config.historyPath));
+    }
 
     // Display welcome message and instructions
     cout << "<><><><><><><><><><><><><><><><><>\n";
@@ -1016,14 +2842,19 @@ int main() {
     
     // Main game loop
     while (again && player.getBalance() > 5) {
-    // Initialize player, deal initial cards, and play a round
-    player.initialize(10);
-    player.dealInitialCards(2);
+    // Deal the initial cards and play a round
+    engine.startRound();
 
     // Play a round and update player balance and experience level
-    again = playRound(player, experienceLevel, shop);
-    saveBalance(player, "balance.bin");
-    experienceLevel.saveExperience("experience.bin");
+    again = playRound(engine, shop, hints, recorder);
+    if (historyFile) {
+        recordHistory(engine, history);
+        if (history.getRounds() == LIVE_HISTORY_CHUNK_ROUNDS) {
+            history.finish();
+            historyFile->commit(historyChunks++, history);
+            history.clear();
+        }
+    }
 
     // Check if the player's balance is below the minimum bet
     if (player.getBalance() < 5) {
@@ -1031,17 +2862,37 @@ int main() {
         cout << "\n!-------------------------------------------------!\n";
         cout << " Sorry! Your balance is lower than the minimum bet.\n";
         cout << " Your balance has been reset.\n";
-        resetBalanceFile(player, "balance.bin");
-        experienceLevel.resetXPFile(experienceLevel, "experience.bin");
+        resetProfile(recorder, player, experienceLevel);
         cout << "!-------------------------------------------------!\n";
         // Exit the loop to end the game
         break;
     }
 
-    // Prompt the player for shop interactions
-    promptForShop(player, shop);
+    // Prompt the player for shop interactions; a purchase is journaled right away
+    visitShop(player, shop, recorder);
     }
 
+// Take a last snapshot so the next start has nothing to replay, then write and sync everything.
+// The journal is only emptied once that snapshot is on the disk.
+if (historyFile) {
+    history.finish();
+    if (history.getRounds() > 0) {
+        historyFile->commit(historyChunks++, history);
+    }
+    if (!historyFile->close()) {
+        cout << " Unable to save hand history to " << historyFile->getPath() << endl;
+    }
+}
+recorder.snapshot();
+if (!journal.sync()) {
+    cout << " Unable to save journal to " << journal.getPath() << endl;
+}
+if (!writer.close()) {
+    cout << " Unable to save profile to " << profileName << endl;
+} else {
+    journal.truncate();
+}
+
 // End of the program
 return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,394 @@
+/*
+ * File:   odds.h
+ *
+ * Purpose: Exact probabilities of how the dealer's hand ends, for an infinite deck
+ *          or for the cards left in a finite shoe, and the expected value of the
+ *          player's actions for the cards left in the shoe.
+ */
+
+#ifndef ODDS_H
+#define ODDS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <unordered_map>
+#include "dealer.h"
+
+// The dealer either stands on 17-21 or busts
+const int DEALER_RESULTS = 6;
+const int DEALER_BUST = 5;
+static_assert(DEALER_STAND_TOTAL == 17, "DealerDistribution has one slot per standing total from 17 to 21");
+
+// Upcard 0 means the dealer has no card yet. In this game the dealer draws the whole hand after the
+// player is done, so that is the case the game itself uses; 1-10 are Ace through ten-valued cards.
+const int NO_UPCARD = 0;
+const int UPCARDS = 11;
+
+// Number of distinct card values: Ace, 2-9 and the ten-valued cards
+const int CARD_VALUES = 10;
+
+// Index (0-9) of a card's value for a rank (0 = Ace, 12 = King); 10, J, Q and K share index 9
+constexpr int valueIndex(int rank) {
+    return rank >= 9 ? 9 : rank;
+}
+
+// Probability of each way the dealer's hand can end
+struct DealerDistribution {
+    double probability[DEALER_RESULTS] = {};  // [0-4] stand on 17-21, [5] bust
+
+    // Slot for the state the dealer stopped in
+    static constexpr int slot(const DealerTransition& state) {
+        return state.bust ? DEALER_BUST : state.total() - DEALER_STAND_TOTAL;
+    }
+
+    // Adds another distribution weighted by a probability
+    constexpr void add(const DealerDistribution& other, double weight) {
+        for (int i = 0; i < DEALER_RESULTS; i++) {
+            probability[i] += weight * other.probability[i];
+        }
+    }
+
+    constexpr double bust() const {
+        return probability[DEALER_BUST];
+    }
+};
+
+// Remaining cards in a shoe, counted by value index (0 = Aces, 1-8 = 2-9, 9 = tens and faces)
+struct ShoeComposition {
+    int counts[CARD_VALUES] = {};
+    int total = 0;
+
+    // Composition of a freshly shuffled shoe
+    static ShoeComposition fullShoe(int decks) {
+        ShoeComposition shoe;
+        for (int i = 0; i < CARD_VALUES; i++) {
+            shoe.counts[i] = (i == 9 ? 16 : 4) * decks;
+        }
+        shoe.total = 52 * decks;
+        return shoe;
+    }
+
+    void remove(int value) {
+        counts[value]--;
+        total--;
+    }
+
+    void add(int value) {
+        counts[value]++;
+        total++;
+    }
+
+    // Packs the counts into 62 bits: 6 bits for each non-ten value and 8 bits for the tens,
+    // which is enough for shoes of up to 8 decks
+    uint64_t pack() const {
+        uint64_t key = static_cast<uint64_t>(counts[9]);
+        for (int i = 0; i < 9; i++) {
+            key = (key << 6) | static_cast<uint64_t>(counts[i]);
+        }
+        return key;
+    }
+};
+
+// Dealer outcome probabilities for an infinite deck, where every value has a fixed probability.
+// Every draw raises the hard total, so each state only depends on states with higher hard totals
+// and the whole table is filled in one pass from 21 down to 0 at compile time.
+class InfiniteDealerOdds {
+private:
+    DealerDistribution states[DealerTable::MAX_HARD_TOTAL + 1][2] = {};
+
+public:
+    constexpr InfiniteDealerOdds() {
+        for (int hard = DealerTable::MAX_HARD_TOTAL; hard >= 0; hard--) {
+            for (int soft = 0; soft < 2; soft++) {
+                DealerDistribution& distribution = states[hard][soft];
+                for (int value = 0; value < CARD_VALUES; value++) {
+                    double probability = (value == 9 ? 4.0 : 1.0) / 13.0;
+                    const DealerTransition& next = DEALER_TABLE.next(hard, soft, value);
+                    if (next.stand) {
+                        distribution.probability[DealerDistribution::slot(next)] += probability;
+                    } else {
+                        distribution.add(states[next.hardTotal][next.soft], probability);
+                    }
+                }
+            }
+        }
+    }
+
+    // Distribution from any state the dealer would keep drawing in
+    constexpr const DealerDistribution& fromState(int hardTotal, bool soft) const {
+        return states[hardTotal][soft];
+    }
+
+    // Distribution for an upcard value (1 = Ace, 10 = ten-valued) or NO_UPCARD
+    constexpr const DealerDistribution& forUpcard(int upcard) const {
+        if (upcard == NO_UPCARD) {
+            return states[0][0];
+        }
+        const DealerTransition& first = DEALER_TABLE.next(0, false, upcard - 1);
+        return states[first.hardTotal][first.soft];
+    }
+};
+
+constexpr InfiniteDealerOdds INFINITE_DEALER_ODDS;
+
+// Dealer outcome probabilities when drawing without replacement from a finite shoe. Results are
+// memoized on (remaining composition, dealer state), so draw sequences that reach the same
+// composition in a different order are only solved once, and later queries reuse the cache.
+class DealerOdds {
+private:
+    struct Key {
+        uint64_t composition;
+        int state;
+
+        bool operator==(const Key& other) const {
+            return composition == other.composition && state == other.state;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t hash = key.composition * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(key.state);
+            return static_cast<size_t>(hash ^ (hash >> 29));
+        }
+    };
+
+    std::unordered_map<Key, DealerDistribution, KeyHash> cache;
+
+public:
+    // Distribution from a drawing state, with shoe holding the cards the dealer can still draw.
+    // The shoe is modified while recursing but restored before returning.
+    const DealerDistribution& fromState(ShoeComposition& shoe, int hardTotal, bool soft) {
+        Key key = {shoe.pack(), hardTotal * 2 + soft};
+        auto found = cache.find(key);
+        if (found != cache.end()) {
+            return found->second;
+        }
+
+        // An empty shoe would be reshuffled, which is closest to the infinite-deck odds
+        DealerDistribution distribution;
+        if (shoe.total == 0) {
+            distribution = INFINITE_DEALER_ODDS.fromState(hardTotal, soft);
+        }
+        for (int value = 0; value < CARD_VALUES && shoe.total > 0; value++) {
+            if (shoe.counts[value] == 0) {
+                continue;
+            }
+            double probability = static_cast<double>(shoe.counts[value]) / shoe.total;
+            const DealerTransition& next = DEALER_TABLE.next(hardTotal, soft, value);
+            if (next.stand) {
+                distribution.probability[DealerDistribution::slot(next)] += probability;
+            } else {
+                shoe.remove(value);
+                distribution.add(fromState(shoe, next.hardTotal, next.soft), probability);
+                shoe.add(value);
+            }
+        }
+        return cache[key] = distribution;
+    }
+
+    // Distribution for an upcard value (1 = Ace, 10 = ten-valued) or NO_UPCARD.
+    // The upcard itself must already be removed from the shoe.
+    const DealerDistribution& forUpcard(ShoeComposition& shoe, int upcard) {
+        if (upcard == NO_UPCARD) {
+            return fromState(shoe, 0, false);
+        }
+        const DealerTransition& first = DEALER_TABLE.next(0, false, upcard - 1);
+        return fromState(shoe, first.hardTotal, first.soft);
+    }
+
+    // Number of memoized states
+    size_t cacheSize() const {
+        return cache.size();
+    }
+
+    void clear() {
+        cache.clear();
+    }
+};
+
+// Payouts of this game per unit bet, as settled by GameEngine. The bet is not taken when it is placed,
+// so a normal win adds 2x the bet, any 21 adds 3x and a loss or bust takes the bet.
+// A double down pays the original bet up front and doubles the bet for settlement.
+struct PayoutRules {
+    double win = 2.0;            // Dealer busts or the player's total is higher
+    double twentyOne = 3.0;      // Any 21, on the first two cards, after a hit or on a double down
+    double tie = 0.0;            // Totals are equal
+    double loss = 1.0;           // Taken when the dealer's total is higher or the player busts
+    double doubleStake = 2.0;    // Bet multiple settled after doubling down
+    double doubleCost = 1.0;     // Paid up front when doubling down
+    double betMultiplier = 1.0;  // Shop bet multiplier, applied to winnings only
+};
+
+// Expected balance change per unit bet of each action, plus the chance that one more card busts
+struct ActionValues {
+    double stand = 0.0;
+    double hit = 0.0;
+    double doubleDown = 0.0;
+    double bustChance = 0.0;
+};
+
+// Expected values of standing, hitting and doubling down for a player total against the cards left
+// in the shoe, under the game's PayoutRules. The player's draws are taken from the exact remaining
+// composition; the dealer's results are computed once per decision from the cards left at that point
+// and reused for every card the player might draw after it. This is the usual fixed-dealer-odds
+// approximation of a composition-dependent calculator: it is off by a small fraction of a percent
+// with several decks and keeps a cold decision well under a millisecond.
+// Solved states are kept in a hash table keyed by the packed compositions, so repeated decisions
+// from the same shoe are lookups.
+class EVCalculator {
+private:
+    struct Key {
+        uint64_t root;         // Composition at the decision the dealer odds were computed for
+        uint64_t composition;  // Composition after the player's later draws
+        int situation;
+
+        bool operator==(const Key& other) const {
+            return root == other.root && composition == other.composition && situation == other.situation;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t hash = (key.root * 0x9e3779b97f4a7c15ULL ^ key.composition) * 0xbf58476d1ce4e5b9ULL
+                            + static_cast<uint64_t>(key.situation);
+            return static_cast<size_t>(hash ^ (hash >> 29));
+        }
+    };
+
+    // Values of standing and of hitting, then playing on optimally
+    struct StateValue {
+        double stand;
+        double hit;
+        double bustChance;
+    };
+
+    PayoutRules rules;
+    DealerOdds dealerOdds;
+    std::unordered_map<Key, StateValue, KeyHash> cache;
+    size_t maxCacheSize;
+
+    // Expected value per unit bet of standing on a total against the dealer
+    double standValue(const DealerDistribution& dealer, int total) const {
+        double winPayout = rules.win * rules.betMultiplier;
+        double value = dealer.bust() * winPayout;
+        for (int dealerTotal = DEALER_STAND_TOTAL; dealerTotal <= 21; dealerTotal++) {
+            double probability = dealer.probability[dealerTotal - DEALER_STAND_TOTAL];
+            if (dealerTotal > total) {
+                value -= probability * rules.loss;
+            } else if (dealerTotal == total) {
+                value += probability * rules.tie;
+            } else {
+                value += probability * winPayout;
+            }
+        }
+        return value;
+    }
+
+    // Solves standing and hitting for a player state. The hand arithmetic of a draw (hard total,
+    // soft Ace, bust) is the same for the player and the dealer, so it comes from the dealer table.
+    StateValue solve(ShoeComposition& shoe, int total, bool soft, int upcard,
+                     const DealerDistribution& dealer, uint64_t root) {
+        Key key = {root, shoe.pack(), (total * 2 + soft) * UPCARDS + upcard};
+        auto found = cache.find(key);
+        if (found != cache.end()) {
+            return found->second;
+        }
+
+        StateValue value;
+        value.stand = standValue(dealer, total);
+        value.hit = value.stand;
+        value.bustChance = 0.0;
+
+        // An empty shoe is reshuffled before the next draw; treat hitting it as standing
+        if (shoe.total > 0) {
+            int hardTotal = soft ? total - 10 : total;
+            value.hit = 0.0;
+            for (int card = 0; card < CARD_VALUES; card++) {
+                if (shoe.counts[card] == 0) {
+                    continue;
+                }
+                double probability = static_cast<double>(shoe.counts[card]) / shoe.total;
+                const DealerTransition& next = DEALER_TABLE.next(hardTotal, soft, card);
+                if (next.bust) {
+                    value.hit -= probability * rules.loss;
+                    value.bustChance += probability;
+                } else if (next.total() == 21) {
+                    value.hit += probability * rules.twentyOne * rules.betMultiplier;
+                } else {
+                    shoe.remove(card);
+                    StateValue after = solve(shoe, next.total(), next.soft, upcard, dealer, root);
+                    shoe.add(card);
+                    value.hit += probability * std::max(after.stand, after.hit);
+                }
+            }
+        }
+
+        if (cache.size() >= maxCacheSize) {
+            cache.clear();
+        }
+        cache[key] = value;
+        return value;
+    }
+
+    // Expected value of doubling down: one more card, then stand with the doubled bet
+    double doubleValue(const ShoeComposition& shoe, int total, bool soft, const DealerDistribution& dealer) const {
+        double value = -rules.doubleCost;
+        if (shoe.total == 0) {
+            return value + rules.doubleStake * standValue(dealer, total);
+        }
+
+        int hardTotal = soft ? total - 10 : total;
+        for (int card = 0; card < CARD_VALUES; card++) {
+            if (shoe.counts[card] == 0) {
+                continue;
+            }
+            double probability = static_cast<double>(shoe.counts[card]) / shoe.total;
+            const DealerTransition& next = DEALER_TABLE.next(hardTotal, soft, card);
+            if (next.bust) {
+                value -= probability * rules.doubleStake * rules.loss;
+            } else if (next.total() == 21) {
+                value += probability * rules.doubleStake * rules.twentyOne * rules.betMultiplier;
+            } else {
+                value += probability * rules.doubleStake * standValue(dealer, next.total());
+            }
+        }
+        return value;
+    }
+
+public:
+    // Constructor: the caches are cleared whenever they reach maxEntries entries
+    explicit EVCalculator(const PayoutRules& payoutRules = PayoutRules(), size_t maxEntries = 1 << 20)
+        : rules(payoutRules), maxCacheSize(maxEntries) {}
+
+    // Values of each action for a player total below 21, a dealer upcard (NO_UPCARD in this game)
+    // and the cards still in the shoe, with the player's and the upcard's cards already removed
+    ActionValues evaluate(const ShoeComposition& composition, int total, bool soft, int upcard = NO_UPCARD) {
+        if (dealerOdds.cacheSize() >= maxCacheSize) {
+            dealerOdds.clear();
+        }
+
+        ShoeComposition shoe = composition;
+        DealerDistribution dealer = dealerOdds.forUpcard(shoe, upcard);
+        StateValue state = solve(shoe, total, soft, upcard, dealer, shoe.pack());
+
+        ActionValues values;
+        values.stand = state.stand;
+        values.hit = state.hit;
+        values.bustChance = state.bustChance;
+        values.doubleDown = doubleValue(shoe, total, soft, dealer);
+        return values;
+    }
+
+    const PayoutRules& getRules() const {
+        return rules;
+    }
+
+    // Changes the payout rules; cached values were solved for the old rules and are dropped
+    void setRules(const PayoutRules& payoutRules) {
+        rules = payoutRules;
+        cache.clear();
+    }
+};
+
+#endif /* ODDS_H */
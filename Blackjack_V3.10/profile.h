@@ -0,0 +1,267 @@
+/*
+ * File:   profile.h
+ *
+ * Purpose: The player's saved profile: one fixed-layout, versioned and checksummed record
+ *          holding everything that used to live in balance.bin and experience.bin and more.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+const uint32_t PROFILE_MAGIC = 0x46504a42;  // "BJPF" in a little-endian file
+const uint16_t PROFILE_VERSION = 2;
+
+// On-disk layout of version 2. Every field has a fixed size and offset, so a record is read and
+// written as one block; fields are added by bumping the version and using the reserved bytes.
+// Version 2 took four of them for journalSequence; they are zero in version 1 records, which is
+// what a profile saved before there was a journal should have, so those still load.
+struct ProfileRecord {
+    uint32_t magic = PROFILE_MAGIC;
+    uint16_t version = PROFILE_VERSION;
+    uint16_t size = 0;            // sizeof(ProfileRecord), set when saved
+    uint64_t sequence = 0;        // Incremented on every save; the newest valid copy wins
+    float balance = 100.00f;
+    int32_t level = 1;
+    int32_t experiencePoints = 0;
+    float xpMultiplier = 1.0f;
+    float betMultiplier = 1.0f;
+    uint8_t doubleDown = 0;
+    uint8_t reserved[3] = {};
+    uint32_t journalSequence = 0; // Last journal entry included in this record
+    uint32_t checksum = 0;        // FNV-1a of every byte before it
+};
+
+static_assert(sizeof(ProfileRecord) == 48, "ProfileRecord is an on-disk format and must not change size");
+static_assert(offsetof(ProfileRecord, checksum) == 44, "checksum must cover every other byte");
+static_assert(offsetof(ProfileRecord, journalSequence) == 40, "journalSequence must use the version 1 reserved bytes");
+
+// 32-bit FNV-1a hash of a block of bytes
+inline uint32_t fnv1a(const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Checksum of a record, covering every byte before the checksum field
+inline uint32_t profileChecksum(const ProfileRecord& record) {
+    return fnv1a(&record, offsetof(ProfileRecord, checksum));
+}
+
+// Whether a record read from disk is complete, of a version this build reads and undamaged
+inline bool isValidProfile(const ProfileRecord& record) {
+    return record.magic == PROFILE_MAGIC && record.version >= 1 && record.version <= PROFILE_VERSION
+           && record.size == sizeof(ProfileRecord) && record.checksum == profileChecksum(record);
+}
+
+// A stamped profile record waiting to be written at an offset of an open file
+struct PendingWrite {
+    int descriptor;
+    off_t offset;
+    ProfileRecord record;
+};
+
+// Storage that profile records are saved to
+class ProfileStore {
+public:
+    virtual ~ProfileStore() {}
+
+    // Reads the last saved record; returns false if there is none
+    virtual bool load(ProfileRecord& record) = 0;
+
+    // Saves a record; it may only reach the disk at the next sync()
+    virtual bool save(ProfileRecord record) = 0;
+
+    // Waits until every saved record is on the disk
+    virtual bool sync() = 0;
+};
+
+// The profile file holds two copies of the record. Each save overwrites the older copy with a
+// single pwrite, so a save interrupted half-way can only damage the copy being replaced, and
+// loading picks the valid copy with the highest sequence number. The file stays open between saves.
+class ProfileFile : public ProfileStore {
+private:
+    std::string path;
+    int descriptor;
+    uint64_t sequence;  // Sequence number of the last record loaded or saved
+
+public:
+    // Constructor: opens (or creates) the profile file at the given path
+    explicit ProfileFile(const std::string& filename)
+        : path(filename), descriptor(open(filename.c_str(), O_RDWR | O_CREAT | O_BINARY, 0644)), sequence(0) {}
+
+    ~ProfileFile() {
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+    }
+
+    ProfileFile(const ProfileFile&) = delete;
+    ProfileFile& operator=(const ProfileFile&) = delete;
+
+    // Reads the newest valid copy of the record; returns false if there is none (a new file)
+    bool load(ProfileRecord& record) override {
+        if (descriptor < 0) {
+            return false;
+        }
+        ProfileRecord copies[2];
+        ssize_t bytes = pread(descriptor, copies, sizeof(copies), 0);
+        bool found = false;
+        for (int slot = 0; slot < 2; slot++) {
+            bool complete = bytes >= static_cast<ssize_t>((slot + 1) * sizeof(ProfileRecord));
+            if (complete && isValidProfile(copies[slot]) && (!found || copies[slot].sequence > record.sequence)) {
+                record = copies[slot];
+                found = true;
+            }
+        }
+        if (found) {
+            sequence = record.sequence;
+        }
+        return found;
+    }
+
+    // Stamps the record as the next save and works out where it goes (over the older copy) without
+    // writing it, so that many profiles can be written in one batch
+    bool prepare(ProfileRecord record, PendingWrite& write) {
+        if (descriptor < 0) {
+            return false;
+        }
+        record.magic = PROFILE_MAGIC;
+        record.version = PROFILE_VERSION;
+        record.size = sizeof(ProfileRecord);
+        record.sequence = ++sequence;
+        record.checksum = profileChecksum(record);
+        write.descriptor = descriptor;
+        write.offset = static_cast<off_t>(record.sequence % 2) * sizeof(ProfileRecord);
+        write.record = record;
+        return true;
+    }
+
+    // Writes the record over the older copy in one system call
+    bool save(ProfileRecord record) override {
+        PendingWrite write;
+        return prepare(record, write)
+               && pwrite(write.descriptor, &write.record, sizeof(write.record), write.offset) == static_cast<ssize_t>(sizeof(write.record));
+    }
+
+    bool sync() override {
+        return descriptor >= 0 && fsync(descriptor) == 0;
+    }
+
+    const std::string& getPath() const {
+        return path;
+    }
+};
+
+// Write-behind saving on a thread of its own. submit() only copies the record into a single pending
+// slot and returns, so the game never waits on the disk. Every record replaces the one before it, so
+// a record submitted while another is still waiting simply overwrites it, and the writer only ever
+// writes the latest one. Writes are synced to the disk at most once per sync interval, and close()
+// writes and syncs whatever is left.
+class ProfileWriter {
+private:
+    ProfileStore& store;
+    std::chrono::milliseconds syncInterval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    ProfileRecord latest;
+    bool pending = false;
+    bool stopping = false;
+    bool failed = false;
+    std::thread worker;
+
+    void run() {
+        std::chrono::steady_clock::time_point lastSync = std::chrono::steady_clock::now();
+        bool dirty = false;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (dirty) {
+                wake.wait_until(lock, lastSync + syncInterval, [this] { return pending || stopping; });
+            } else {
+                wake.wait(lock, [this] { return pending || stopping; });
+            }
+
+            bool write = pending;
+            ProfileRecord record = latest;
+            pending = false;
+            bool stop = stopping;
+            lock.unlock();
+
+            bool ok = true;
+            if (write) {
+                ok = store.save(record);
+                dirty = true;
+            }
+            if (dirty && (stop || std::chrono::steady_clock::now() - lastSync >= syncInterval)) {
+                ok = store.sync() && ok;
+                lastSync = std::chrono::steady_clock::now();
+                dirty = false;
+            }
+
+            lock.lock();
+            failed = failed || !ok;
+            if (stop && !pending && !dirty) {
+                return;
+            }
+        }
+    }
+
+public:
+    // Constructor: starts the writer thread for the given store
+    explicit ProfileWriter(ProfileStore& profileStore,
+                           std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+        : store(profileStore), syncInterval(interval) {
+        worker = std::thread(&ProfileWriter::run, this);
+    }
+
+    ~ProfileWriter() {
+        close();
+    }
+
+    ProfileWriter(const ProfileWriter&) = delete;
+    ProfileWriter& operator=(const ProfileWriter&) = delete;
+
+    // Hands a record to the writer thread without waiting for the disk
+    void submit(const ProfileRecord& record) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            latest = record;
+            pending = true;
+        }
+        wake.notify_one();
+    }
+
+    // Writes and syncs everything submitted so far and stops the thread.
+    // Returns false if any write or sync failed.
+    bool close() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        return !failed;
+    }
+};
+
+#endif /* PROFILE_H */
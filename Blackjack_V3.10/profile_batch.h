@@ -0,0 +1,266 @@
+/*
+ * File:   profile_batch.h
+ *
+ * Purpose: Writes many saved profiles at once: every dirty profile's write, and its fsync, is
+ *          queued to the kernel in one batch through io_uring on Linux, or written one after
+ *          the other with pwrite where io_uring is not available. The game itself only ever has
+ *          one profile to save and saves it through ProfileWriter; batches are measured against
+ *          per-file saves by --bench-storage.
+ */
+
+#ifndef PROFILE_BATCH_H
+#define PROFILE_BATCH_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include "profile.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+// Writes a batch of profile records and optionally syncs each one's file
+class BatchBackend {
+public:
+    virtual ~BatchBackend() {}
+
+    // Writes every record, then syncs its file if sync is set. Returns false if any write or sync failed.
+    // The records must stay where they are until the call returns.
+    virtual bool write(const PendingWrite* writes, int count, bool sync) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// The fallback: one pwrite, and one fsync, after another
+class PwriteBackend : public BatchBackend {
+public:
+    bool write(const PendingWrite* writes, int count, bool sync) override {
+        bool ok = true;
+        for (int i = 0; i < count; i++) {
+            const PendingWrite& write = writes[i];
+            ok = pwrite(write.descriptor, &write.record, sizeof(write.record), write.offset)
+                 == static_cast<ssize_t>(sizeof(write.record)) && ok;
+            if (sync) {
+                ok = fsync(write.descriptor) == 0 && ok;
+            }
+        }
+        return ok;
+    }
+
+    const char* name() const override {
+        return "pwrite";
+    }
+};
+
+#ifdef HAVE_IO_URING
+// io_uring through the raw system calls, so no library is needed. Each record becomes a write
+// entry on the submission ring, linked to an fsync entry when syncing, and a whole ring of them is
+// handed to the kernel with one io_uring_enter that also waits for them all to complete. The
+// kernel runs the writes and the fsyncs of different files in parallel.
+class IoUringBackend : public BatchBackend {
+private:
+    int ring;
+    unsigned entries;
+    void* sqMemory;
+    size_t sqSize;
+    void* cqMemory;
+    size_t cqSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+
+    // Unmaps the rings and closes the ring's descriptor
+    void release() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqMemory != MAP_FAILED && cqMemory != sqMemory) {
+            munmap(cqMemory, cqSize);
+        }
+        if (sqMemory != MAP_FAILED) {
+            munmap(sqMemory, sqSize);
+        }
+        if (ring >= 0) {
+            close(ring);
+        }
+        sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        sqMemory = cqMemory = MAP_FAILED;
+        ring = -1;
+    }
+
+    // Adds an entry to the submission ring; it is only seen by the kernel once the tail is published
+    io_uring_sqe& queue(unsigned& tail) {
+        unsigned index = tail++ & *sqMask;
+        sqArray[index] = index;
+        io_uring_sqe& sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        return sqe;
+    }
+
+    // Submits the queued entries and reaps them all. Returns false if any of them failed.
+    bool submit(unsigned tail, unsigned count) {
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        bool ok = true;
+        unsigned toSubmit = count;
+        unsigned reaped = 0;
+        while (reaped < count) {
+            int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ring, toSubmit, count - reaped,
+                                                     IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (submitted < 0 && errno != EINTR) {
+                return false;
+            }
+            if (submitted > 0) {
+                toSubmit -= static_cast<unsigned>(submitted);
+            }
+
+            unsigned head = *cqHead;
+            unsigned completed = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != completed; head++) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                // user_data holds the bytes the entry must return: the record's size, or 0 for an fsync
+                ok = ok && cqe.res == static_cast<int>(cqe.user_data);
+                reaped++;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+        return ok;
+    }
+
+public:
+    // Constructor: sets up a ring with room for the given number of entries. Check isOpen(): the
+    // kernel may not support io_uring or may not allow it.
+    explicit IoUringBackend(unsigned ringEntries = 256)
+        : ring(-1), entries(0), sqMemory(MAP_FAILED), sqSize(0), cqMemory(MAP_FAILED), cqSize(0),
+          sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), sqesSize(0) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring = static_cast<int>(syscall(__NR_io_uring_setup, ringEntries, &params));
+        if (ring < 0) {
+            return;
+        }
+        entries = params.sq_entries;
+
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqSize = cqSize = sqSize > cqSize ? sqSize : cqSize;
+        }
+        sqMemory = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        cqMemory = singleMap ? sqMemory
+                 : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                               ring, IORING_OFF_SQES));
+        if (sqMemory == MAP_FAILED || cqMemory == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            return;
+        }
+
+        unsigned char* sq = static_cast<unsigned char*>(sqMemory);
+        unsigned char* cq = static_cast<unsigned char*>(cqMemory);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUringBackend() {
+        release();
+    }
+
+    IoUringBackend(const IoUringBackend&) = delete;
+    IoUringBackend& operator=(const IoUringBackend&) = delete;
+
+    bool isOpen() const {
+        return ring >= 0;
+    }
+
+    bool write(const PendingWrite* writes, int count, bool sync) override {
+        if (ring < 0) {
+            return false;
+        }
+        unsigned perWrite = sync ? 2 : 1;
+        unsigned tail = *sqTail;
+        unsigned queued = 0;
+        bool ok = true;
+        for (int i = 0; i < count; i++) {
+            if (queued + perWrite > entries) {
+                ok = submit(tail, queued) && ok;
+                queued = 0;
+            }
+            const PendingWrite& write = writes[i];
+            io_uring_sqe& sqe = queue(tail);
+            sqe.opcode = IORING_OP_WRITE;
+            sqe.fd = write.descriptor;
+            sqe.addr = reinterpret_cast<uint64_t>(&write.record);
+            sqe.len = sizeof(write.record);
+            sqe.off = static_cast<uint64_t>(write.offset);
+            sqe.user_data = sizeof(write.record);
+            if (sync) {
+                // The fsync only starts once the write is done, and is cancelled if it failed
+                sqe.flags = IOSQE_IO_LINK;
+                io_uring_sqe& fsyncSqe = queue(tail);
+                fsyncSqe.opcode = IORING_OP_FSYNC;
+                fsyncSqe.fd = write.descriptor;
+                fsyncSqe.user_data = 0;
+            }
+            queued += perWrite;
+        }
+        if (queued > 0) {
+            ok = submit(tail, queued) && ok;
+        }
+        return ok;
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+};
+#endif
+
+// Collects the profiles that changed and writes them all in one batch
+class ProfileBatch {
+private:
+    BatchBackend& backend;
+    std::vector<PendingWrite> pending;
+
+public:
+    explicit ProfileBatch(BatchBackend& batchBackend) : backend(batchBackend) {}
+
+    // Queues a profile's record; nothing is written until flush()
+    bool add(ProfileFile& profile, const ProfileRecord& record) {
+        PendingWrite write;
+        if (!profile.prepare(record, write)) {
+            return false;
+        }
+        pending.push_back(write);
+        return true;
+    }
+
+    // Writes, and if sync is set syncs, every queued record. Returns false if any of them failed.
+    bool flush(bool sync = true) {
+        bool ok = backend.write(pending.data(), static_cast<int>(pending.size()), sync);
+        pending.clear();
+        return ok;
+    }
+};
+
+#endif /* PROFILE_BATCH_H */
@@ -0,0 +1,451 @@
+/*
+ * File:   profile_table.h
+ *
+ * Purpose: Profiles of many players in one memory-mapped file of fixed-size slots, shared by
+ *          every game process. The file is its own id -> slot index, so a profile is loaded or
+ *          saved with a hash, a probe and a copy under a file lock, without opening or closing
+ *          anything.
+ */
+
+#ifndef PROFILE_TABLE_H
+#define PROFILE_TABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "profile.h"
+
+const uint32_t PROFILE_TABLE_MAGIC = 0x54504a42;  // "BJPT" in a little-endian file
+const uint16_t PROFILE_TABLE_VERSION = 1;
+
+// One copy of a player's profile, exactly one cache line
+struct alignas(64) ProfileLine {
+    uint64_t playerId = 0;  // 0 marks an empty slot
+    ProfileRecord record;
+    uint8_t padding[8] = {};
+};
+
+// A player's slot: like ProfileFile, two copies of the record so a save interrupted half-way can
+// only damage the copy being replaced. Each copy has a cache line to itself.
+struct ProfileSlot {
+    ProfileLine copies[2];
+};
+
+// First cache line of the file
+struct alignas(64) ProfileTableHeader {
+    uint32_t magic = PROFILE_TABLE_MAGIC;
+    uint16_t version = PROFILE_TABLE_VERSION;
+    uint16_t slotSize = sizeof(ProfileSlot);
+    uint64_t capacity = 0;  // Number of slots, a power of two
+    uint64_t count = 0;     // Number of slots in use
+};
+
+static_assert(sizeof(ProfileLine) == 64, "ProfileLine must fill exactly one cache line");
+static_assert(sizeof(ProfileSlot) == 128, "ProfileSlot is an on-disk format and must not change size");
+static_assert(sizeof(ProfileTableHeader) == 64, "slots must start on a cache line");
+
+// Player id for an account name: the 64-bit FNV-1a hash of the name, never 0. A million accounts
+// have about a one in thirty million chance of any two sharing an id.
+inline uint64_t playerIdFor(const std::string& name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char character : name) {
+        hash = (hash ^ character) * 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+// The table is an open-addressing hash table with linear probing, mapped with MAP_SHARED. Only the
+// pages of the slots that are probed are ever read, so the resident set stays at a few pages per
+// player used however many profiles the file holds; the kernel is told not to read ahead. When the
+// table is three quarters full it is rebuilt at twice the size in a new file that then replaces it.
+//
+// Every game with --player is its own process, and they all share the file. A new table or a
+// grown one is always built in a file of its own and renamed into place, so no process ever maps
+// a table without its header. Processes agree through flock on filename.lock, which is never
+// replaced: creating, growing and taking a slot for a new player hold it exclusively, and loads
+// and saves hold it shared, so a table cannot be replaced between finding a slot and writing it.
+// A process whose mapped file has been replaced by another's grow() maps the new one first.
+// Within a process, loads and saves must not run on two threads at the same time.
+class ProfileTable {
+private:
+    std::string path;
+    int lockDescriptor;
+    int descriptor;
+    void* mapping;
+    size_t mappedSize;
+    dev_t mappedDevice;
+    ino_t mappedInode;
+    ProfileTableHeader* header;
+    ProfileSlot* slots;
+
+    // Holds flock on the lock file until it goes out of scope
+    class FileLock {
+    private:
+        int file;
+        bool held;
+
+    public:
+        FileLock(int lockFile, int operation) : file(lockFile), held(false) {
+            if (file >= 0) {
+                int result;
+                while ((result = flock(file, operation)) != 0 && errno == EINTR) {
+                }
+                held = result == 0;
+            }
+        }
+
+        ~FileLock() {
+            if (held) {
+                flock(file, LOCK_UN);
+            }
+        }
+
+        FileLock(const FileLock&) = delete;
+        FileLock& operator=(const FileLock&) = delete;
+
+        bool isHeld() const {
+            return held;
+        }
+    };
+
+    static size_t fileSize(uint64_t capacity) {
+        return sizeof(ProfileTableHeader) + capacity * sizeof(ProfileSlot);
+    }
+
+    // Spreads the id's bits so that consecutive ids land far apart (the splitmix64 finalizer)
+    static uint64_t mix(uint64_t id) {
+        id = (id ^ (id >> 30)) * 0xbf58476d1ce4e5b9ull;
+        id = (id ^ (id >> 27)) * 0x94d049bb133111ebull;
+        return id ^ (id >> 31);
+    }
+
+    // Returns true if a header read from a file of the given size describes a table that fits in
+    // the file. The capacity is checked against the size by division, so no corrupt value can wrap.
+    static bool isValidHeader(const ProfileTableHeader& existing, uint64_t size) {
+        return existing.magic == PROFILE_TABLE_MAGIC && existing.version == PROFILE_TABLE_VERSION
+               && existing.slotSize == sizeof(ProfileSlot)
+               && existing.capacity != 0 && (existing.capacity & (existing.capacity - 1)) == 0
+               && existing.count <= existing.capacity
+               && size >= sizeof(ProfileTableHeader)
+               && existing.capacity <= (size - sizeof(ProfileTableHeader)) / sizeof(ProfileSlot);
+    }
+
+    // Makes an empty table with the given number of slots in a file of its own and maps it. The
+    // caller fills it and renames it into place.
+    static int build(const std::string& filename, uint64_t capacity, void*& memory, size_t& size) {
+        int file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0644);
+        if (file < 0) {
+            return -1;
+        }
+        ProfileTableHeader fresh;
+        fresh.capacity = capacity;
+        size = fileSize(capacity);
+        if (ftruncate(file, size) != 0 || pwrite(file, &fresh, sizeof(fresh), 0) != sizeof(fresh)) {
+            close(file);
+            return -1;
+        }
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (memory == MAP_FAILED) {
+            close(file);
+            return -1;
+        }
+        madvise(memory, size, MADV_RANDOM);
+        return file;
+    }
+
+    // Syncs a built table to the disk and renames it over the path. The built file is removed if
+    // it cannot be put in place.
+    bool publish(const std::string& builtPath, int file, void* memory, size_t size) {
+        if (msync(memory, size, MS_SYNC) != 0 || rename(builtPath.c_str(), path.c_str()) != 0) {
+            munmap(memory, size);
+            close(file);
+            remove(builtPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Maps the table at the path if it has a valid header. Sets missing if there is no file or it
+    // is empty, so there is nothing to keep.
+    int mapExisting(void*& memory, size_t& size, struct stat& status, bool& missing) const {
+        int file = open(path.c_str(), O_RDWR | O_BINARY);
+        missing = file < 0 && errno == ENOENT;
+        if (file < 0) {
+            return -1;
+        }
+        ProfileTableHeader existing;
+        if (fstat(file, &status) != 0) {
+            close(file);
+            return -1;
+        }
+        missing = status.st_size == 0;
+        if (pread(file, &existing, sizeof(existing), 0) != sizeof(existing)
+            || !isValidHeader(existing, static_cast<uint64_t>(status.st_size))) {
+            close(file);
+            return -1;
+        }
+        size = fileSize(existing.capacity);
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if (memory == MAP_FAILED) {
+            close(file);
+            return -1;
+        }
+        madvise(memory, size, MADV_RANDOM);
+        return file;
+    }
+
+    // Maps the table at the path, creating it with the given number of slots if there is none. A
+    // file whose header is damaged or does not fit its size is moved aside to filename.damaged and
+    // a new table is created in its place, the way the other profile files start over from a
+    // damaged record. The caller holds the lock exclusively.
+    bool attach(uint64_t capacity) {
+        void* memory = nullptr;
+        size_t size = 0;
+        struct stat status;
+        bool missing = false;
+        int file = mapExisting(memory, size, status, missing);
+        if (file < 0) {
+            if (!missing) {
+                std::string damagedPath = path + ".damaged";
+                if (rename(path.c_str(), damagedPath.c_str()) != 0) {
+                    return false;
+                }
+            }
+            std::string newPath = path + ".new";
+            file = build(newPath, capacity, memory, size);
+            if (file < 0 || !publish(newPath, file, memory, size)) {
+                return false;
+            }
+            fstat(file, &status);
+        }
+        unmap();
+        adopt(file, memory, size, status);
+        return true;
+    }
+
+    // Maps the file now at the path if another process has replaced the one mapped here. The
+    // caller holds the lock, so the file cannot be replaced again meanwhile.
+    bool refresh() {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0) {
+            return false;
+        }
+        if (status.st_dev == mappedDevice && status.st_ino == mappedInode) {
+            return true;
+        }
+        void* memory = nullptr;
+        size_t size = 0;
+        bool missing = false;
+        int file = mapExisting(memory, size, status, missing);
+        if (file < 0) {
+            return false;
+        }
+        unmap();
+        adopt(file, memory, size, status);
+        return true;
+    }
+
+    void unmap() {
+        if (header != nullptr) {
+            munmap(mapping, mappedSize);
+            close(descriptor);
+        }
+        descriptor = -1;
+        mapping = nullptr;
+        header = nullptr;
+        slots = nullptr;
+    }
+
+    void adopt(int file, void* memory, size_t size, const struct stat& status) {
+        descriptor = file;
+        mapping = memory;
+        mappedSize = size;
+        mappedDevice = status.st_dev;
+        mappedInode = status.st_ino;
+        header = static_cast<ProfileTableHeader*>(memory);
+        slots = reinterpret_cast<ProfileSlot*>(static_cast<unsigned char*>(memory) + sizeof(ProfileTableHeader));
+    }
+
+    // Slot of the player, or the empty slot where the player would go; null if the table is full
+    static ProfileSlot* probe(ProfileSlot* table, uint64_t capacity, uint64_t playerId) {
+        uint64_t mask = capacity - 1;
+        uint64_t index = mix(playerId) & mask;
+        for (uint64_t step = 0; step < capacity; step++) {
+            ProfileSlot& slot = table[(index + step) & mask];
+            if (slot.copies[0].playerId == playerId || slot.copies[0].playerId == 0) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    // Rebuilds the table at twice the size next to the file, then renames it over the file. The
+    // caller holds the lock exclusively, so no other process writes to the old table meanwhile.
+    bool grow() {
+        std::string grownPath = path + ".grow";
+        void* memory = nullptr;
+        size_t size = 0;
+        int file = build(grownPath, header->capacity * 2, memory, size);
+        if (file < 0) {
+            return false;
+        }
+        ProfileTableHeader* grownHeader = static_cast<ProfileTableHeader*>(memory);
+        ProfileSlot* grownSlots = reinterpret_cast<ProfileSlot*>(static_cast<unsigned char*>(memory) + sizeof(ProfileTableHeader));
+        for (uint64_t index = 0; index < header->capacity; index++) {
+            if (slots[index].copies[0].playerId != 0) {
+                *probe(grownSlots, grownHeader->capacity, slots[index].copies[0].playerId) = slots[index];
+                grownHeader->count++;
+            }
+        }
+        if (!publish(grownPath, file, memory, size)) {
+            return false;
+        }
+        struct stat status;
+        fstat(file, &status);
+        unmap();
+        adopt(file, memory, size, status);
+        return true;
+    }
+
+    // Writes the record over the older copy in the slot
+    static void write(ProfileSlot& slot, ProfileRecord record) {
+        uint64_t newest = 0;
+        for (const ProfileLine& copy : slot.copies) {
+            if (isValidProfile(copy.record) && copy.record.sequence > newest) {
+                newest = copy.record.sequence;
+            }
+        }
+        record.magic = PROFILE_MAGIC;
+        record.version = PROFILE_VERSION;
+        record.size = sizeof(ProfileRecord);
+        record.sequence = newest + 1;
+        record.checksum = profileChecksum(record);
+        slot.copies[record.sequence % 2].record = record;
+    }
+
+public:
+    // Constructor: maps the table at the given path, creating it with the given number of slots
+    // (rounded up to a power of two) if it does not exist yet
+    explicit ProfileTable(const std::string& filename, uint64_t initialCapacity = 1024)
+        : path(filename), lockDescriptor(open((filename + ".lock").c_str(), O_RDWR | O_CREAT | O_BINARY, 0644)),
+          descriptor(-1), mapping(nullptr), mappedSize(0), mappedDevice(0), mappedInode(0), header(nullptr),
+          slots(nullptr) {
+        uint64_t capacity = 16;
+        while (capacity < initialCapacity) {
+            capacity *= 2;
+        }
+        FileLock lock(lockDescriptor, LOCK_EX);
+        if (lock.isHeld()) {
+            attach(capacity);
+        }
+    }
+
+    ~ProfileTable() {
+        unmap();
+        if (lockDescriptor >= 0) {
+            close(lockDescriptor);
+        }
+    }
+
+    ProfileTable(const ProfileTable&) = delete;
+    ProfileTable& operator=(const ProfileTable&) = delete;
+
+    // Copies the newest valid copy of the player's record; returns false for a new player
+    bool load(uint64_t playerId, ProfileRecord& record) {
+        FileLock lock(lockDescriptor, LOCK_SH);
+        if (header == nullptr || !lock.isHeld() || !refresh()) {
+            return false;
+        }
+        const ProfileSlot* slot = probe(slots, header->capacity, playerId);
+        if (slot == nullptr || slot->copies[0].playerId != playerId) {
+            return false;
+        }
+        bool found = false;
+        for (const ProfileLine& copy : slot->copies) {
+            if (isValidProfile(copy.record) && (!found || copy.record.sequence > record.sequence)) {
+                record = copy.record;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Writes the player's record over the older copy in the player's slot, taking a slot for a new
+    // player. The write lands in the page cache; sync() flushes it to the disk.
+    bool save(uint64_t playerId, ProfileRecord record) {
+        if (header == nullptr || playerId == 0) {
+            return false;
+        }
+        {
+            FileLock lock(lockDescriptor, LOCK_SH);
+            if (!lock.isHeld() || !refresh()) {
+                return false;
+            }
+            ProfileSlot* slot = probe(slots, header->capacity, playerId);
+            if (slot != nullptr && slot->copies[0].playerId == playerId) {
+                write(*slot, record);
+                return true;
+            }
+        }
+
+        // A new player: another process may have taken slots or grown the table since the lock
+        // was last held, so the slot is looked up again with the lock held exclusively
+        FileLock lock(lockDescriptor, LOCK_EX);
+        if (!lock.isHeld() || !refresh()) {
+            return false;
+        }
+        ProfileSlot* slot = probe(slots, header->capacity, playerId);
+        if (slot == nullptr || slot->copies[0].playerId != playerId) {
+            if ((header->count + 1) * 4 > header->capacity * 3 && !grow()) {
+                return false;
+            }
+            slot = probe(slots, header->capacity, playerId);
+            slot->copies[0].playerId = playerId;
+            slot->copies[1].playerId = playerId;
+            header->count++;
+        }
+        write(*slot, record);
+        return true;
+    }
+
+    // Flushes every saved record to the disk. A table grown by another process since the last save
+    // was synced by that process with this one's records in it.
+    bool sync() {
+        return header != nullptr && msync(mapping, mappedSize, MS_SYNC) == 0;
+    }
+
+    const std::string& getPath() const {
+        return path;
+    }
+};
+
+// One player's profile in a ProfileTable, so a ProfileWriter can save it like a ProfileFile
+class ProfileTableEntry : public ProfileStore {
+private:
+    ProfileTable& table;
+    uint64_t playerId;
+
+public:
+    ProfileTableEntry(ProfileTable& profileTable, uint64_t id) : table(profileTable), playerId(id) {}
+
+    bool load(ProfileRecord& record) override {
+        return table.load(playerId, record);
+    }
+
+    bool save(ProfileRecord record) override {
+        return table.save(playerId, record);
+    }
+
+    bool sync() override {
+        return table.sync();
+    }
+};
+
+#endif /* PROFILE_TABLE_H */
@@ -0,0 +1,103 @@
+/*
+ * File:   random.h
+ *
+ * Purpose: Random number generators used to shuffle the shoe.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// Interface for the random number generators that shuffle and deal cards
+class RandomEngine {
+public:
+    virtual ~RandomEngine() {}
+
+    // Restarts the generator from the given seed
+    virtual void seed(uint64_t value) = 0;
+
+    // Returns the next 64 random bits
+    virtual uint64_t next() = 0;
+
+    // Advances the generator as if next() had been called 2^128 times, so that the streams
+    // before and after a jump never overlap and can be handed to parallel workers
+    virtual void jump() = 0;
+
+    // Returns an unbiased random number in [0, range) using Lemire's multiply-shift method,
+    // which only divides in the rare case where a draw has to be rejected
+    uint32_t bounded(uint32_t range) {
+        uint64_t product = (next() >> 32) * range;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < range) {
+            uint32_t threshold = (0u - range) % range;
+            while (low < threshold) {
+                product = (next() >> 32) * range;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+};
+
+// xoshiro256** by David Blackman and Sebastiano Vigna: 256 bits of state, period 2^256 - 1
+class Xoshiro256StarStar : public RandomEngine {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    // Constructor: seeds the generator with the given value
+    explicit Xoshiro256StarStar(uint64_t value = 0) {
+        seed(value);
+    }
+
+    // Expands the seed into the full state with splitmix64, as recommended by the authors
+    void seed(uint64_t value) override {
+        for (int i = 0; i < 4; i++) {
+            value += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = value;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            state[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() override {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+
+        return result;
+    }
+
+    void jump() override {
+        static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        uint64_t jumped[4] = {0, 0, 0, 0};
+        for (uint64_t word : JUMP) {
+            for (int bit = 0; bit < 64; bit++) {
+                if (word & (1ULL << bit)) {
+                    for (int i = 0; i < 4; i++) {
+                        jumped[i] ^= state[i];
+                    }
+                }
+                next();
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            state[i] = jumped[i];
+        }
+    }
+};
+
+#endif /* RANDOM_H */
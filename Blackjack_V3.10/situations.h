@@ -0,0 +1,210 @@
+/*
+ * File:   situations.h
+ *
+ * Purpose: Queries over a hand history by situation: the player's total, whether it was soft, the
+ *          dealer's card and the action taken, answered from the situation index recorded with
+ *          the history instead of decoding every round.
+ */
+
+#ifndef SITUATIONS_H
+#define SITUATIONS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "history.h"
+
+// What to look for; -1 in any field matches every value. Rounds are numbered from 0 in file order,
+// and only rounds in [firstRound, lastRound) are counted; lastRound -1 means to the end.
+struct SituationQuery {
+    int total = -1;
+    int soft = -1;
+    int upcard = -1;
+    int action = -1;
+    long long firstRound = 0;
+    long long lastRound = -1;
+
+    bool matches(int key) const {
+        return (total < 0 || key >> 7 == total) && (soft < 0 || (key >> 6 & 1) == soft)
+               && (upcard < 0 || (key >> 2 & 0xf) == upcard) && (action < 0 || (key & 0x3) == action);
+    }
+};
+
+// Decisions that matched a query, by the outcome of their round
+struct SituationResult {
+    long long decisions = 0;
+    long long outcomes[HISTORY_OUTCOMES] = {};
+    long long indexRows = 0;      // Index rows summed
+    long long decodedRounds = 0;  // Rounds decoded because their chunk was only partly in range
+};
+
+// A history and its situation index, opened for queries. The index is loaded into one table whose
+// rows are a situation's counts in one chunk, sorted by situation and then chunk, with each outcome
+// in a column of its own. The chunks a query covers completely are then a range of consecutive rows
+// for every matching situation, summed column by column in loops the compiler vectorizes; only the
+// chunks at the ends of a round range are decoded from the history. Chunks without an index, as in
+// a history recorded before there was one, are decoded too.
+class SituationIndex {
+private:
+    // Where a chunk of the history is, and the number of its first round
+    struct Chunk {
+        const uint8_t* data;
+        size_t bytes;
+        uint32_t rounds;
+        long long firstRound;
+    };
+
+    HistoryReader history;
+    ChunkFileReader index;
+    std::vector<Chunk> chunks;
+    long long indexedChunks = 0;
+    long long rounds = 0;
+    uint32_t keyStart[SITUATION_KEYS + 1] = {};        // Rows of situation k are keyStart[k] to keyStart[k + 1]
+    std::vector<uint32_t> rowChunk;                    // Chunk of each row
+    std::vector<uint32_t> rowOutcomes[HISTORY_OUTCOMES];
+
+    // Counts the matching decisions of the rounds of a chunk that are in range by decoding them
+    void decode(const Chunk& chunk, const SituationQuery& query, long long first, long long last,
+                SituationResult& result) const {
+        HistoryChunkReader reader(chunk.data, chunk.bytes, chunk.rounds);
+        HistoryRound round;
+        for (long long number = chunk.firstRound; number < last && reader.next(round); number++) {
+            if (number < first || round.outcome < 0 || round.outcome >= HISTORY_OUTCOMES) {
+                continue;
+            }
+            result.decodedRounds++;
+            forEachDecision(round, [&](int key) {
+                if (query.matches(key)) {
+                    result.decisions++;
+                    result.outcomes[round.outcome]++;
+                }
+            });
+        }
+    }
+
+public:
+    // Constructor: maps the history and its index, the history's name with ".idx" added, and loads
+    // the index. Takes a pass over the index, which is a small fraction of the history.
+    explicit SituationIndex(const std::string& filename)
+        : history(filename), index(filename + ".idx", SITUATION_MAGIC, HISTORY_VERSION) {
+        history.forEachChunk([&](const uint8_t* data, size_t bytes, uint32_t chunkRounds) {
+            chunks.push_back(Chunk{data, bytes, chunkRounds, rounds});
+            rounds += chunkRounds;
+        });
+
+        // Count each situation's rows, then place them: chunks are read in order, so the rows of
+        // every situation come out sorted by chunk. Indexing stops at the first chunk that does not
+        // match the history's.
+        auto forEachEntry = [&](auto visit) {
+            long long chunk = 0;
+            index.forEachChunk([&](const uint8_t* data, size_t bytes, uint32_t chunkRounds) {
+                if (chunk == indexedChunks && chunk < static_cast<long long>(chunks.size())
+                    && chunks[chunk].rounds == chunkRounds) {
+                    for (size_t offset = 0; offset + sizeof(SituationEntry) <= bytes; offset += sizeof(SituationEntry)) {
+                        SituationEntry entry;
+                        memcpy(&entry, data + offset, sizeof(entry));
+                        if (entry.key < SITUATION_KEYS) {
+                            visit(entry, static_cast<uint32_t>(chunk));
+                        }
+                    }
+                    indexedChunks++;
+                }
+                chunk++;
+            });
+        };
+        std::vector<uint32_t> nextRow(SITUATION_KEYS);
+        forEachEntry([&](const SituationEntry& entry, uint32_t) {
+            nextRow[entry.key]++;
+        });
+        for (int key = 0; key < SITUATION_KEYS; key++) {
+            keyStart[key + 1] = keyStart[key] + nextRow[key];
+        }
+        rowChunk.resize(keyStart[SITUATION_KEYS]);
+        for (std::vector<uint32_t>& column : rowOutcomes) {
+            column.resize(keyStart[SITUATION_KEYS]);
+        }
+        std::copy(keyStart, keyStart + SITUATION_KEYS, nextRow.begin());
+        indexedChunks = 0;
+        forEachEntry([&](const SituationEntry& entry, uint32_t chunk) {
+            uint32_t row = nextRow[entry.key]++;
+            rowChunk[row] = chunk;
+            for (int outcome = 0; outcome < HISTORY_OUTCOMES; outcome++) {
+                rowOutcomes[outcome][row] = entry.outcomes[outcome];
+            }
+        });
+    }
+
+    SituationIndex(const SituationIndex&) = delete;
+    SituationIndex& operator=(const SituationIndex&) = delete;
+
+    bool isValid() const {
+        return history.isValid();
+    }
+
+    long long getRounds() const {
+        return rounds;
+    }
+
+    // Chunks answered from the index; the others have to be decoded
+    long long getIndexedChunks() const {
+        return indexedChunks;
+    }
+
+    long long getChunks() const {
+        return static_cast<long long>(chunks.size());
+    }
+
+    // Counts the decisions matching a query by the outcome of their round
+    SituationResult query(const SituationQuery& query) const {
+        SituationResult result;
+        long long first = std::max(query.firstRound, 0LL);
+        long long last = query.lastRound < 0 ? rounds : std::min(query.lastRound, rounds);
+        if (first >= last) {
+            return result;
+        }
+
+        // Indexed chunks that lie completely in range, [fullFirst, fullLast)
+        auto chunkAfter = [&](long long round) {
+            return std::upper_bound(chunks.begin(), chunks.end(), round,
+                                    [](long long number, const Chunk& chunk) { return number < chunk.firstRound; })
+                   - chunks.begin();
+        };
+        long long firstChunk = chunkAfter(first) - 1;
+        long long lastChunk = chunkAfter(last - 1);
+        long long fullFirst = chunks[firstChunk].firstRound == first ? firstChunk : firstChunk + 1;
+        long long fullLast = last == chunks[lastChunk - 1].firstRound + chunks[lastChunk - 1].rounds ? lastChunk : lastChunk - 1;
+        fullLast = std::max(std::min(fullLast, indexedChunks), fullFirst);
+
+        for (int key = 0; key < SITUATION_KEYS; key++) {
+            if (keyStart[key] == keyStart[key + 1] || !query.matches(key)) {
+                continue;
+            }
+            const uint32_t* chunkBegin = rowChunk.data() + keyStart[key];
+            const uint32_t* chunkEnd = rowChunk.data() + keyStart[key + 1];
+            size_t begin = std::lower_bound(chunkBegin, chunkEnd, static_cast<uint32_t>(fullFirst)) - rowChunk.data();
+            size_t end = std::lower_bound(chunkBegin, chunkEnd, static_cast<uint32_t>(fullLast)) - rowChunk.data();
+            result.indexRows += end - begin;
+            for (int outcome = 0; outcome < HISTORY_OUTCOMES; outcome++) {
+                const uint32_t* column = rowOutcomes[outcome].data();
+                uint64_t sum = 0;
+                for (size_t row = begin; row < end; row++) {
+                    sum += column[row];
+                }
+                result.outcomes[outcome] += sum;
+                result.decisions += sum;
+            }
+        }
+
+        // The chunks the index did not cover
+        for (long long chunk = firstChunk; chunk < lastChunk; chunk++) {
+            if (chunk < fullFirst || chunk >= fullLast) {
+                decode(chunks[chunk], query, first, last, result);
+            }
+        }
+        return result;
+    }
+};
+
+#endif /* SITUATIONS_H */
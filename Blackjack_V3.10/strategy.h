@@ -0,0 +1,57 @@
+/*
+ * File:   strategy.h
+ *
+ * Purpose: Layout of the precomputed hit/stand/double tables written by strategy_gen
+ *          into strategy_table.h, and the lookups used by auto-play and hints.
+ */
+
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include "odds.h"
+
+// One letter per decision, so every table row reads like a printed strategy chart
+const char STRATEGY_STAND = 'S';
+const char STRATEGY_HIT = 'H';
+const char STRATEGY_DOUBLE_OR_HIT = 'D';    // Double down on the first two cards, otherwise hit
+const char STRATEGY_DOUBLE_OR_STAND = 'd';  // Double down on the first two cards, otherwise stand
+
+// The shop sells bet multipliers of 0.5x, 1x and 1.5x and the player starts at 1x. Winnings are scaled
+// by the multiplier while losses are not, which changes the best play, so each one has its own table.
+const int STRATEGY_BET_MULTIPLIERS = 3;
+constexpr float STRATEGY_MULTIPLIERS[STRATEGY_BET_MULTIPLIERS] = {0.5f, 1.0f, 1.5f};
+
+// Player totals 0-21 index the rows; unreachable totals hit and 21 stands
+const int STRATEGY_TOTALS = 22;
+
+// Best decision for every (bet multiplier, soft flag, player total, dealer upcard), one byte each.
+// Column 0 is NO_UPCARD, the case this game plays; columns 1-10 are Ace through ten-valued upcards.
+struct StrategyTable {
+    int decks;
+    char actions[STRATEGY_BET_MULTIPLIERS][2][STRATEGY_TOTALS][UPCARDS + 1];
+
+    // Index of the table for a bet multiplier, picking the closest one the shop sells
+    static constexpr int multiplierIndex(float betMultiplier) {
+        return betMultiplier < 0.75f ? 0 : (betMultiplier < 1.25f ? 1 : 2);
+    }
+
+    // Decision letter for a hand; a single array lookup
+    constexpr char action(int total, bool soft, float betMultiplier = 1.0f, int upcard = NO_UPCARD) const {
+        return total >= STRATEGY_TOTALS ? STRATEGY_STAND
+                                        : actions[multiplierIndex(betMultiplier)][soft][total][upcard];
+    }
+
+    // Whether to double down on the first two cards
+    constexpr bool doubleDown(int total, bool soft, float betMultiplier = 1.0f, int upcard = NO_UPCARD) const {
+        return action(total, soft, betMultiplier, upcard) == STRATEGY_DOUBLE_OR_HIT
+               || action(total, soft, betMultiplier, upcard) == STRATEGY_DOUBLE_OR_STAND;
+    }
+
+    // Whether to hit once doubling is no longer offered
+    constexpr bool hit(int total, bool soft, float betMultiplier = 1.0f, int upcard = NO_UPCARD) const {
+        return action(total, soft, betMultiplier, upcard) == STRATEGY_HIT
+               || action(total, soft, betMultiplier, upcard) == STRATEGY_DOUBLE_OR_HIT;
+    }
+};
+
+#endif /* STRATEGY_H */
@@ -0,0 +1,118 @@
+/*
+ * File:   strategy_gen.cpp
+ *
+ * Purpose: Solves the best hit/stand/double decision for every player total, soft flag,
+ *          dealer upcard and shop bet multiplier, and prints them as strategy_table.h.
+ *          The Makefile runs it before building the game:
+ *
+ *          strategy_gen [--decks D] [--win W] [--twenty-one T] [--tie E] [--loss L] > strategy_table.h
+ */
+
+//System Libraries
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+//User Libraries
+#include "odds.h"
+#include "strategy.h"
+
+// Removes a typical two-card hand for the total from the shoe: Ace plus a card for soft totals,
+// a ten plus a card for hard 12-20 and a 2 plus a card for hard 4-11
+void removeHand(ShoeComposition& shoe, int total, bool soft) {
+    if (soft) {
+        shoe.remove(valueIndex(0));
+        shoe.remove(valueIndex(total - 12));
+    } else if (total >= 12) {
+        shoe.remove(valueIndex(9));
+        shoe.remove(valueIndex(total - 11));
+    } else {
+        shoe.remove(valueIndex(1));
+        shoe.remove(valueIndex(total - 3));
+    }
+}
+
+// Solves one cell of the table against a full shoe with the hand and the upcard taken out
+char solveAction(EVCalculator& calculator, int decks, int total, bool soft, int upcard) {
+    // Totals no two-card hand can have: below 4, or soft below 12
+    if (total < 4 || (soft && total < 12)) {
+        return STRATEGY_HIT;
+    }
+    if (total >= 21) {
+        return STRATEGY_STAND;
+    }
+
+    ShoeComposition shoe = ShoeComposition::fullShoe(decks);
+    removeHand(shoe, total, soft);
+    if (upcard != NO_UPCARD) {
+        shoe.remove(upcard - 1);
+    }
+
+    ActionValues values = calculator.evaluate(shoe, total, soft, upcard);
+    bool hit = values.hit > values.stand;
+    if (values.doubleDown > max(values.hit, values.stand)) {
+        return hit ? STRATEGY_DOUBLE_OR_HIT : STRATEGY_DOUBLE_OR_STAND;
+    }
+    return hit ? STRATEGY_HIT : STRATEGY_STAND;
+}
+
+int main(int argc, char* argv[]) {
+    // Defaults are the payouts GameEngine settles with and the game's default shoe
+    int decks = 6;
+    PayoutRules rules;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--decks") == 0 && i + 1 < argc) {
+            decks = min(max(atoi(argv[++i]), 1), 8);
+        } else if (strcmp(argv[i], "--win") == 0 && i + 1 < argc) {
+            rules.win = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--twenty-one") == 0 && i + 1 < argc) {
+            rules.twentyOne = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tie") == 0 && i + 1 < argc) {
+            rules.tie = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            rules.loss = atof(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--decks D] [--win W] [--twenty-one T] [--tie E] [--loss L]\n";
+            return 1;
+        }
+    }
+
+    cout << "/*\n";
+    cout << " * File:   strategy_table.h\n";
+    cout << " *\n";
+    cout << " * Purpose: Generated by strategy_gen - do not edit. Rebuild with make STRATEGY_DECKS=D.\n";
+    cout << " *          " << decks << " decks, win " << rules.win << ", twenty-one " << rules.twentyOne
+         << ", tie " << rules.tie << ", loss " << rules.loss << "\n";
+    cout << " */\n\n";
+    cout << "#ifndef STRATEGY_TABLE_H\n";
+    cout << "#define STRATEGY_TABLE_H\n\n";
+    cout << "#include \"strategy.h\"\n\n";
+    cout << "// Rows are player totals 0-21; columns are no upcard, then Ace through ten\n";
+    cout << "constexpr StrategyTable STRATEGY_TABLE = {" << decks << ", {\n";
+
+    for (int multiplier = 0; multiplier < STRATEGY_BET_MULTIPLIERS; multiplier++) {
+        PayoutRules multiplied = rules;
+        multiplied.betMultiplier = STRATEGY_MULTIPLIERS[multiplier];
+        EVCalculator calculator(multiplied);
+
+        cout << "    {   // " << STRATEGY_MULTIPLIERS[multiplier] << "x bet multiplier\n";
+        for (int soft = 0; soft < 2; soft++) {
+            cout << "        {   // " << (soft ? "Soft" : "Hard") << " totals\n";
+            for (int total = 0; total < STRATEGY_TOTALS; total++) {
+                cout << "            \"";
+                for (int upcard = 0; upcard < UPCARDS; upcard++) {
+                    cout << solveAction(calculator, decks, total, soft, upcard);
+                }
+                cout << "\"" << (total + 1 < STRATEGY_TOTALS ? "," : "") << "\n";
+            }
+            cout << "        }" << (soft == 0 ? "," : "") << "\n";
+        }
+        cout << "    }" << (multiplier + 1 < STRATEGY_BET_MULTIPLIERS ? "," : "") << "\n";
+    }
+
+    cout << "}};\n\n";
+    cout << "#endif /* STRATEGY_TABLE_H */\n";
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * File:   strategy_table.h
+ *
+ * Purpose: Generated by strategy_gen - do not edit. Rebuild with make STRATEGY_DECKS=D.
+ *          6 decks, win 2, twenty-one 3, tie 0, loss 1
+ */
+
+#ifndef STRATEGY_TABLE_H
+#define STRATEGY_TABLE_H
+
+#include "strategy.h"
+
+// Rows are player totals 0-21; columns are no upcard, then Ace through ten
+constexpr StrategyTable STRATEGY_TABLE = {6, {
+    {   // 0.5x bet multiplier
+        {   // Hard totals
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHSSSHHHH",
+            "HHSSSSSHHHH",
+            "HHSSSSSHHHH",
+            "SHSSSSSHHHH",
+            "SHSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS"
+        },
+        {   // Soft totals
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHSSSSSSSHH",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS"
+        }
+    },
+    {   // 1x bet multiplier
+        {   // Hard totals
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "DHDDDDDDHHH",
+            "HHHHHHHHHHH",
+            "HHHHSSSHHHH",
+            "HHSSSSSHHHH",
+            "HHSSSSSHHHH",
+            "SHSSSSSHHHH",
+            "SHSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS"
+        },
+        {   // Soft totals
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHSSHHH",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS"
+        }
+    },
+    {   // 1.5x bet multiplier
+        {   // Hard totals
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHDDDHHHH",
+            "DHDDDDDDDDH",
+            "DDDDDDDDDDD",
+            "HHHHHHHHHHH",
+            "HHHHSSSHHHH",
+            "HHSSSSSHHHH",
+            "HHSSSSSHHHH",
+            "SHSSSSSHHHH",
+            "SHSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS"
+        },
+        {   // Soft totals
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHHHHHH",
+            "HHHHHHDHHHH",
+            "HHHHHDDHHHH",
+            "HHHHDDDHHHH",
+            "HHHHDDDHHHH",
+            "HHHDDDDHHHH",
+            "HHDDDDDHHHH",
+            "HHDDDDDSHHH",
+            "SSSddddSSSS",
+            "SSSSSSSSSSS",
+            "SSSSSSSSSSS"
+        }
+    }
+}};
+
+#endif /* STRATEGY_TABLE_H */
@@ -0,0 +1,180 @@
+/*
+ * File:   situations_test.cpp
+ *
+ * Purpose: Records rounds played by the game engine in a hand history and checks that situation
+ *          queries answered from its index count the same decisions as decoding every round,
+ *          including the rounds the player busted or won with 21 before the dealer played.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+// The game's classes are only defined in main.cpp, so it is compiled in here with its main() renamed
+#define main blackjackMain
+#include "../main.cpp"
+#undef main
+
+const long long TEST_ROUNDS = 200000;
+const uint32_t TEST_CHUNK_ROUNDS = 4096;
+const uint64_t TEST_SEED = 20240611;
+
+int failures = 0;
+
+// Reports a failed check in the form the NetBeans test runner reads
+void check(bool passed, const char* test, const string& message) {
+    if (!passed) {
+        cout << "%TEST_FAILED% time=0 testname=" << test << " (situations_test) message=" << message << endl;
+        failures++;
+    }
+}
+
+// Plays rounds with the strategy table and records them in chunks. Checks on the way that the upcard
+// of every round settled before the dealer played is the card the next round is dealt first.
+void recordRounds(const string& path) {
+    Xoshiro256StarStar stream(TEST_SEED);
+    Player player;
+    ExperienceLevel experienceLevel;
+    player.setBalance(100.00);
+    Shoe shoe(6, 0.75, stream);
+    GameEngine engine(player, experienceLevel, shoe);
+    TablePolicy policy;
+    SimulationStats stats;
+
+    HistoryFile file(path);
+    HistoryChunk chunk(TEST_CHUNK_ROUNDS);
+    long long chunks = 0;
+    long long unplayed = 0;
+    long long mismatched = 0;
+    bool previousUnplayed = false;
+    Card previousUpcard;
+    for (long long round = 0; round < TEST_ROUNDS; round++) {
+        bool shuffled = shoe.needsShuffle();
+        simulateRound(engine, policy, stats);
+        if (previousUnplayed && !shuffled) {
+            mismatched += engine.getPlayer().getCards().begin()->getIndex() != previousUpcard.getIndex();
+        }
+        previousUnplayed = engine.getDealerCards().size() == 0;
+        previousUpcard = engine.getUpcard();
+        unplayed += previousUnplayed;
+
+        recordHistory(engine, chunk);
+        if (chunk.getRounds() == TEST_CHUNK_ROUNDS || round + 1 == TEST_ROUNDS) {
+            chunk.finish();
+            file.commit(chunks++, chunk);
+            chunk.clear();
+        }
+    }
+    check(file.close(), "upcard", "the history could not be written");
+    check(unplayed > 0, "upcard", "no round was settled before the dealer played");
+    check(mismatched == 0, "upcard", to_string(mismatched) + " upcards were not the next card dealt");
+}
+
+// Counts the decisions matching a query by decoding every round, working the player's hand out with
+// Hand instead of the index's own situation keys
+SituationResult bruteForce(const string& path, const SituationQuery& query) {
+    SituationResult result;
+    HistoryReader reader(path);
+    long long number = 0;
+    long long last = query.lastRound < 0 ? TEST_ROUNDS : query.lastRound;
+    reader.forEach([&](const HistoryRound& round) {
+        long long roundNumber = number++;
+        if (roundNumber < query.firstRound || roundNumber >= last) {
+            return;
+        }
+        Hand hand;
+        hand.add(Card(round.playerCards[0]));
+        hand.add(Card(round.playerCards[1]));
+        int upcard = Card(round.upcard).getValue();
+        auto count = [&](int action) {
+            if ((query.total < 0 || hand.total() == query.total) && (query.soft < 0 || hand.isSoft() == (query.soft == 1))
+                && (query.upcard < 0 || upcard == query.upcard) && (query.action < 0 || action == query.action)) {
+                result.decisions++;
+                result.outcomes[round.outcome]++;
+            }
+        };
+        if (round.doubledDown) {
+            count(SITUATION_DOUBLE);
+            return;
+        }
+        for (int card = 2; card < round.playerCount; card++) {
+            count(SITUATION_HIT);
+            hand.add(Card(round.playerCards[card]));
+        }
+        if (round.stood) {
+            count(SITUATION_STAND);
+        }
+    });
+    return result;
+}
+
+// Compares indexed queries with decoding every round, over the whole history and over a range that
+// starts and ends inside chunks
+void testQueries(const string& path) {
+    SituationIndex index(path);
+    check(index.isValid() && index.getIndexedChunks() == index.getChunks(), "queries", "the index was not loaded");
+
+    // total, soft, upcard, action
+    const int QUERIES[][4] = {
+        {12, 0, 10, SITUATION_HIT}, {16, 0, 10, -1}, {11, 0, 6, SITUATION_DOUBLE},
+        {18, 1, 9, -1}, {17, 0, 1, SITUATION_STAND}, {-1, -1, 1, -1}, {12, 0, -1, SITUATION_HIT}};
+    const long long RANGES[][2] = {{0, -1}, {1234, 98765}};
+    for (const int* fields : QUERIES) {
+        for (const long long* range : RANGES) {
+            SituationQuery query;
+            query.total = fields[0];
+            query.soft = fields[1];
+            query.upcard = fields[2];
+            query.action = fields[3];
+            query.firstRound = range[0];
+            query.lastRound = range[1];
+            SituationResult indexed = index.query(query);
+            SituationResult decoded = bruteForce(path, query);
+            bool same = indexed.decisions == decoded.decisions && indexed.decisions > 0;
+            for (int outcome = 0; outcome < HISTORY_OUTCOMES; outcome++) {
+                same = same && indexed.outcomes[outcome] == decoded.outcomes[outcome];
+            }
+            check(same, "queries", "total " + to_string(fields[0]) + " soft " + to_string(fields[1]) + " upcard "
+                                   + to_string(fields[2]) + " action " + to_string(fields[3]) + ": "
+                                   + to_string(indexed.decisions) + " indexed, " + to_string(decoded.decisions) + " decoded");
+        }
+    }
+
+    // Busts are counted against a dealer card, and no decision is lost by asking for one. The table
+    // stands on hard 12 against some cards, so those have no hits at all.
+    SituationQuery hit12;
+    hit12.total = 12;
+    hit12.soft = 0;
+    hit12.action = SITUATION_HIT;
+    long long everyUpcard = index.query(hit12).decisions;
+    long long byUpcard = 0;
+    for (int upcard = 1; upcard <= 10; upcard++) {
+        hit12.upcard = upcard;
+        SituationResult result = index.query(hit12);
+        byUpcard += result.decisions;
+        check(result.decisions == 0 || result.outcomes[static_cast<int>(RoundOutcome::Bust)] > 0, "busts",
+              "hard 12 vs " + to_string(upcard) + " hit has no busts");
+    }
+    check(byUpcard == everyUpcard, "busts", to_string(byUpcard) + " decisions by upcard, " + to_string(everyUpcard) + " in all");
+}
+
+int main() {
+    string path = "/tmp/situations_test_" + to_string(getpid()) + ".bin";
+
+    cout << "%SUITE_STARTING% situations_test" << endl;
+    cout << "%SUITE_STARTED%" << endl;
+
+    cout << "%TEST_STARTED% upcard (situations_test)" << endl;
+    recordRounds(path);
+    cout << "%TEST_FINISHED% time=0 upcard (situations_test)" << endl;
+
+    cout << "%TEST_STARTED% queries (situations_test)" << endl;
+    testQueries(path);
+    cout << "%TEST_FINISHED% time=0 queries (situations_test)" << endl;
+
+    cout << "%SUITE_FINISHED% time=0" << endl;
+    remove(path.c_str());
+    remove((path + ".idx").c_str());
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,267 @@
+/*
+ * File:   xp_model.h
+ *
+ * Purpose: Exact model of how many rounds it takes to reach each level, solved as a
+ *          Markov chain over (level, experience points) instead of by simulation.
+ */
+
+#ifndef XP_MODEL_H
+#define XP_MODEL_H
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "odds.h"
+#include "strategy.h"
+
+// Experience points a round can award before the XP multiplier, in GameEngine's order:
+// double down to 21, any other 21, a win, a tie, a loss or bust, a bust after doubling down
+const int XP_AWARDS = 6;
+const int XP_AWARD_POINTS[XP_AWARDS] = {40, 20, 10, 5, -5, -10};
+
+// Probability of each award in one round
+struct XPOutcomes {
+    double probability[XP_AWARDS] = {};
+};
+
+// Awards for a round played with a strategy table against an infinite deck: the player's initial
+// hand, the double-down decision, each hit and the dealer's final total are all summed exactly.
+class TableOutcomes {
+private:
+    const StrategyTable& table;
+    float betMultiplier;
+
+    // Probability of drawing each card value (Ace, 2-9, ten-valued)
+    static double cardProbability(int value) {
+        return (value == 9 ? 4.0 : 1.0) / 13.0;
+    }
+
+    // Standing on a total against the dealer, who draws the whole hand afterwards
+    void stand(int total, double probability, XPOutcomes& outcomes) const {
+        const DealerDistribution& dealer = INFINITE_DEALER_ODDS.forUpcard(NO_UPCARD);
+        outcomes.probability[2] += probability * dealer.bust();
+        for (int dealerTotal = DEALER_STAND_TOTAL; dealerTotal <= 21; dealerTotal++) {
+            double dealerProbability = probability * dealer.probability[dealerTotal - DEALER_STAND_TOTAL];
+            if (dealerTotal > total) {
+                outcomes.probability[4] += dealerProbability;
+            } else if (dealerTotal == total) {
+                outcomes.probability[3] += dealerProbability;
+            } else {
+                outcomes.probability[2] += dealerProbability;
+            }
+        }
+    }
+
+    // Hitting or standing after the double-down decision, following the table
+    void play(int hardTotal, bool soft, double probability, XPOutcomes& outcomes) const {
+        int total = soft ? hardTotal + 10 : hardTotal;
+        if (!table.hit(total, soft, betMultiplier)) {
+            stand(total, probability, outcomes);
+            return;
+        }
+        for (int value = 0; value < CARD_VALUES; value++) {
+            double next = probability * cardProbability(value);
+            const DealerTransition& draw = DEALER_TABLE.next(hardTotal, soft, value);
+            if (draw.bust) {
+                outcomes.probability[4] += next;
+            } else if (draw.total() == 21) {
+                outcomes.probability[1] += next;
+            } else {
+                play(draw.hardTotal, draw.soft, next, outcomes);
+            }
+        }
+    }
+
+public:
+    // Constructor: plays the given table, looked up with the given bet multiplier
+    TableOutcomes(const StrategyTable& strategyTable, float multiplier = 1.0f)
+        : table(strategyTable), betMultiplier(multiplier) {}
+
+    XPOutcomes solve() const {
+        XPOutcomes outcomes;
+        for (int first = 0; first < CARD_VALUES; first++) {
+            for (int second = 0; second < CARD_VALUES; second++) {
+                double probability = cardProbability(first) * cardProbability(second);
+                DealerTransition hand = DEALER_TABLE.next(0, false, first);
+                hand = DEALER_TABLE.next(hand.hardTotal, hand.soft, second);
+                int total = hand.total();
+
+                if (total != 21 && table.doubleDown(total, hand.soft, betMultiplier)) {
+                    for (int value = 0; value < CARD_VALUES; value++) {
+                        double next = probability * cardProbability(value);
+                        const DealerTransition& draw = DEALER_TABLE.next(hand.hardTotal, hand.soft, value);
+                        if (draw.bust) {
+                            outcomes.probability[5] += next;
+                        } else if (draw.total() == 21) {
+                            outcomes.probability[0] += next;
+                        } else {
+                            stand(draw.total(), next, outcomes);
+                        }
+                    }
+                } else if (total == 21) {
+                    outcomes.probability[1] += probability;
+                } else {
+                    play(hand.hardTotal, hand.soft, probability, outcomes);
+                }
+            }
+        }
+        return outcomes;
+    }
+};
+
+// Distribution of the number of rounds needed to reach each level. The state is (level, experience
+// points) and every round moves it by one award, scaled by the XP multiplier and truncated to whole
+// points as GameEngine does for gains. Like ExperienceLevel::gainExperience, a level is gained when
+// the points reach level * 100, which are then taken off. Points are kept in units of the greatest
+// common divisor of every step and threshold, so the chain stays small.
+// The points can go negative without limit in the game; the chain stops them at a floor, which only
+// matters for the very unlikely paths that lose hundreds of points before levelling up.
+class XPProgression {
+private:
+    int targetLevel;
+    int floorPoints;
+    int unit;                        // Points per chain step
+    int steps[XP_AWARDS];            // Change of the state for each award, in units
+    double probability[XP_AWARDS];
+    std::vector<std::vector<double>> firstReached;  // [level][round] chance the level is first reached then
+    std::vector<double> unreached;   // [level] chance the level was not reached within the solved rounds
+
+    static int gcd(int a, int b) {
+        a = std::abs(a);
+        b = std::abs(b);
+        while (b != 0) {
+            int rest = a % b;
+            a = b;
+            b = rest;
+        }
+        return a;
+    }
+
+    // Number of states of a level: from the floor up to one unit below the level's threshold
+    int stateCount(int level) const {
+        return (level * 100 - floorPoints) / unit;
+    }
+
+public:
+    // Constructor: levels 2 to target are modelled, starting from level 1 with 0 points
+    XPProgression(const XPOutcomes& outcomes, float xpMultiplier, int target, int floor = -1000)
+        : targetLevel(std::max(target, 2)), floorPoints(floor), unit(100) {
+        for (int award = 0; award < XP_AWARDS; award++) {
+            int points = XP_AWARD_POINTS[award];
+            steps[award] = points > 0 ? static_cast<int>(points * xpMultiplier) : points;
+            probability[award] = outcomes.probability[award];
+            unit = gcd(unit, steps[award]);
+        }
+        unit = gcd(unit, floorPoints);
+        for (int award = 0; award < XP_AWARDS; award++) {
+            steps[award] /= unit;
+        }
+    }
+
+    // Propagates the state distribution round by round until every level up to the target has been
+    // reached with all but epsilon of the probability, or maxRounds rounds were solved. Each level
+    // only scans the range of points that still holds probability, and states holding less than
+    // PRUNED_MASS are dropped, so levels the chain has left behind cost nothing.
+    void solve(double epsilon = 1e-9, long long maxRounds = 1000000) {
+        const double PRUNED_MASS = 1e-16;
+
+        firstReached.assign(targetLevel + 1, std::vector<double>());
+        unreached.assign(targetLevel + 1, 1.0);
+        unreached[1] = 0.0;
+
+        // Distributions over the points of each level below the target, indexed from the floor.
+        // States are cleared as they are read, so the buffer written next is always empty.
+        std::vector<std::vector<double>> current(targetLevel), next(targetLevel);
+        std::vector<int> low(targetLevel, 0), high(targetLevel, -1);
+        std::vector<int> nextLow(targetLevel), nextHigh(targetLevel);
+        for (int level = 1; level < targetLevel; level++) {
+            current[level].assign(stateCount(level), 0.0);
+            next[level].assign(stateCount(level), 0.0);
+        }
+        low[1] = high[1] = -floorPoints / unit;
+        current[1][low[1]] = 1.0;
+
+        std::vector<double> levelledUp(targetLevel + 1);
+        double pruned = 0.0;
+        bool active = true;
+        for (long long round = 1; round <= maxRounds && active && unreached[targetLevel] - pruned > epsilon; round++) {
+            std::fill(levelledUp.begin(), levelledUp.end(), 0.0);
+            std::fill(nextLow.begin(), nextLow.end(), stateCount(targetLevel));
+            std::fill(nextHigh.begin(), nextHigh.end(), -1);
+
+            for (int level = 1; level < targetLevel; level++) {
+                int threshold = stateCount(level);
+                for (int state = low[level]; state <= high[level]; state++) {
+                    double mass = current[level][state];
+                    current[level][state] = 0.0;
+                    if (mass < PRUNED_MASS) {
+                        pruned += mass;
+                        continue;
+                    }
+                    for (int award = 0; award < XP_AWARDS; award++) {
+                        int moved = std::max(state + steps[award], 0);
+                        double movedMass = mass * probability[award];
+                        int movedLevel = level;
+                        if (moved >= threshold) {
+                            // Level up: the threshold's points are spent
+                            levelledUp[level + 1] += movedMass;
+                            if (level + 1 == targetLevel) {
+                                continue;
+                            }
+                            movedLevel = level + 1;
+                            moved = std::min(moved - threshold - floorPoints / unit, stateCount(movedLevel) - 1);
+                        }
+                        next[movedLevel][moved] += movedMass;
+                        nextLow[movedLevel] = std::min(nextLow[movedLevel], moved);
+                        nextHigh[movedLevel] = std::max(nextHigh[movedLevel], moved);
+                    }
+                }
+            }
+
+            std::swap(current, next);
+            std::swap(low, nextLow);
+            std::swap(high, nextHigh);
+            active = false;
+            for (int level = 1; level < targetLevel; level++) {
+                active = active || low[level] <= high[level];
+            }
+            for (int level = 2; level <= targetLevel; level++) {
+                firstReached[level].push_back(levelledUp[level]);
+                unreached[level] -= levelledUp[level];
+            }
+        }
+    }
+
+    // Expected number of rounds to reach a level; rounds beyond the solved horizon are not counted
+    double expectedRounds(int level) const {
+        double expected = 0.0;
+        for (size_t round = 0; round < firstReached[level].size(); round++) {
+            expected += (round + 1) * firstReached[level][round];
+        }
+        return expected;
+    }
+
+    // Smallest number of rounds within which the level is reached with at least the given chance,
+    // or -1 if that was not reached in the solved rounds
+    long long quantile(int level, double fraction) const {
+        double reached = 0.0;
+        for (size_t round = 0; round < firstReached[level].size(); round++) {
+            reached += firstReached[level][round];
+            if (reached >= fraction) {
+                return static_cast<long long>(round + 1);
+            }
+        }
+        return -1;
+    }
+
+    // Number of rounds that were solved
+    long long getRounds() const {
+        return firstReached.size() > 2 ? static_cast<long long>(firstReached[2].size()) : 0;
+    }
+
+    int getTargetLevel() const {
+        return targetLevel;
+    }
+};
+
+#endif /* XP_MODEL_H */